@@ -6,7 +6,7 @@
 
 QT       += core gui network av avwidgets
 
-CONFIG += c++11
+CONFIG += c++14
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -15,9 +15,18 @@ TEMPLATE = app
 
 SOURCES += examples/main.cpp\
         examples/mainwindow.cpp \
-    youtubeextractor/youtubeextractor.cpp
+    youtubeextractor/youtubeextractor.cpp \
+    youtubeextractor/youtubestreamparser.cpp \
+    youtubeextractor/youtubesharedcache.cpp \
+    youtubeextractor/youtubehlsplaylist.cpp \
+    youtubeextractor/youtubevideometadata.cpp
 
 HEADERS  += examples/mainwindow.h \
-    youtubeextractor/youtubeextractor.h
+    youtubeextractor/youtubeextractor.h \
+    youtubeextractor/youtubeitag.h \
+    youtubeextractor/youtubestreamparser.h \
+    youtubeextractor/youtubesharedcache.h \
+    youtubeextractor/youtubehlsplaylist.h \
+    youtubeextractor/youtubevideometadata.h
 
 FORMS    += examples/mainwindow.ui
@@ -0,0 +1,6 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+TARGET = tst_audiobandwidth
+
+SOURCES += tst_audiobandwidth.cpp
@@ -0,0 +1,228 @@
+#include <QtTest>
+#include <QtNetwork>
+#include "replayserver.h"
+#include "youtubeextractor.h"
+#include "youtubesharedcache.h"
+
+// Playback time the replayed media stands for, in seconds
+const int DEFAULT_SECONDS = 60;
+
+// Measures what audio-only mode saves against fetching the video. The media is
+// made up to the typical bitrates in the itag registry, unless YOUTUBE_REPLAY_DIR
+// names a directory of recordings ("<itag>.media"), all YOUTUBE_REPLAY_SECONDS long.
+class tst_AudioBandwidth : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void bytesPerMinute();
+    void audioOnlyRestoresSettings();
+    void sharedCacheKeepsModesApart();
+    void stalledAudio();
+private:
+    ReplayServer m_server;
+    int m_seconds;
+    int m_videoInfoRequests;
+
+    YouTubeExtractor *createExtractor(QObject *parent);
+    bool extract(YouTubeExtractor *extractor);
+};
+
+void tst_AudioBandwidth::initTestCase()
+{
+    qRegisterMetaType<YouTubeExtractorError>();
+
+    const QString mediaDirectory = QString::fromLocal8Bit(qgetenv("YOUTUBE_REPLAY_DIR"));
+    m_seconds = qEnvironmentVariableIsSet("YOUTUBE_REPLAY_SECONDS")
+            ? qgetenv("YOUTUBE_REPLAY_SECONDS").toInt() : DEFAULT_SECONDS;
+    m_videoInfoRequests = 0;
+    QVERIFY(m_seconds > 0);
+
+    ReplayServer *server = &m_server;
+    int *videoInfoRequests = &m_videoInfoRequests;
+
+    m_server.addHandler("/get_video_info", [server, videoInfoRequests](const ReplayRequest &) {
+        ++*videoInfoRequests;
+
+        QList<ReplayStream> streams;
+        streams << ReplayStream{ 22, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"", server->url("/videoplayback?itag=22") }
+                << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", server->url("/videoplayback?itag=18") };
+
+        QList<ReplayStream> adaptiveStreams;
+        adaptiveStreams << ReplayStream{ 137, "video/mp4; codecs=\"avc1.640028\"", server->url("/videoplayback?itag=137") }
+                        << ReplayStream{ 140, "audio/mp4; codecs=\"mp4a.40.2\"", server->url("/videoplayback?itag=140") }
+                        << ReplayStream{ 251, "audio/webm; codecs=\"opus\"", server->url("/videoplayback?itag=251") };
+
+        return ReplayResponse(200, replayVideoInfo("Replayed video", streams, adaptiveStreams));
+    });
+
+    const int seconds = m_seconds;
+    m_server.addHandler("/videoplayback", [mediaDirectory, seconds](const ReplayRequest &request) {
+        const int itag = QUrlQuery(request.url).queryItemValue("itag").toInt();
+
+        if(!mediaDirectory.isEmpty())
+        {
+            QFile file(mediaDirectory + QString("/%1.media").arg(itag));
+            return file.open(QIODevice::ReadOnly) ? ReplayResponse(200, file.readAll()) : ReplayResponse(404);
+        }
+
+        // kbit/s to bytes over the whole playback time
+        return ReplayResponse(200, QByteArray(YouTubeItag::find(itag).bitrate * 125 * seconds, '\0'));
+    });
+
+    // The first kilobyte of the track arrives, then nothing more
+    m_server.addHandler("/stalled_video_info", [server](const ReplayRequest &) {
+        QList<ReplayStream> adaptiveStreams;
+        adaptiveStreams << ReplayStream{ 140, "audio/mp4; codecs=\"mp4a.40.2\"", server->url("/stalledplayback?itag=140") };
+
+        return ReplayResponse(200, replayVideoInfo("Stalled video", QList<ReplayStream>(), adaptiveStreams));
+    });
+    m_server.addHandler("/stalledplayback", [](const ReplayRequest &) {
+        ReplayResponse response(200, QByteArray(1024, '\0'));
+        response.contentLength = 1024 * 1024;
+        return response;
+    });
+
+    QVERIFY(m_server.start());
+}
+
+void tst_AudioBandwidth::bytesPerMinute()
+{
+    QObject owner;
+
+    YouTubeExtractor *audio = createExtractor(&owner);
+    audio->setAudioOnly(true);
+    QVERIFY(extract(audio));
+    QVERIFY(audio->videoUrl(YouTubeExtractor::Any).isEmpty());
+    QCOMPARE(audio->audioQualities().value(0), YouTubeExtractor::OPUS_160);
+
+    QBuffer track;
+    QVERIFY(track.open(QIODevice::WriteOnly));
+    QSignalSpy audioSpy(audio, SIGNAL(audioReady(YouTubeExtractorError)));
+    audio->streamAudio(&track);
+    QVERIFY(audioSpy.wait(60000));
+    QVERIFY(!audioSpy.first().first().value<YouTubeExtractorError>().isValid());
+
+    const qint64 audioBytes = audio->audioBytesReceived();
+    QCOMPARE(audioBytes, track.size());
+
+    YouTubeExtractor *video = createExtractor(&owner);
+    QVERIFY(extract(video));
+    const QUrl videoUrl = video->videoUrl(YouTubeExtractor::Any);
+    QCOMPARE(QUrlQuery(videoUrl).queryItemValue("itag"), QString("22"));
+
+    QNetworkAccessManager manager;
+    QNetworkReply *reply = manager.get(QNetworkRequest(videoUrl));
+    QSignalSpy videoSpy(reply, SIGNAL(finished()));
+    QVERIFY(videoSpy.wait(60000));
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    const qint64 videoBytes = reply->readAll().size();
+    reply->deleteLater();
+
+    const qint64 audioPerMinute = audioBytes * 60 / m_seconds;
+    const qint64 videoPerMinute = videoBytes * 60 / m_seconds;
+    qDebug("Bytes per minute of playback: audio %lld, videoUrl(Any) %lld, audio is %.1f%% of video",
+           audioPerMinute, videoPerMinute, videoPerMinute ? 100.0 * audioPerMinute / videoPerMinute : 0.0);
+
+    QVERIFY(audioPerMinute > 0);
+    QVERIFY(audioPerMinute < videoPerMinute);
+}
+
+void tst_AudioBandwidth::audioOnlyRestoresSettings()
+{
+    YouTubeExtractor extractor;
+
+    QList<YouTubeExtractor::Quality> qualities;
+    qualities << YouTubeExtractor::MP4_720 << YouTubeExtractor::WEBM_720;
+    extractor.setPreferredVideoQualities(qualities);
+    extractor.setSupportedMediaTypes(YouTubeExtractor::VideoMp4);
+
+    extractor.setAudioOnly(true);
+    QVERIFY(!extractor.preferredVideoQualities().contains(YouTubeExtractor::MP4_720));
+    QCOMPARE(extractor.supportedMediaTypes(), YouTubeExtractor::AudioMp4 | YouTubeExtractor::AudioWebm);
+
+    // Changed in audio-only mode, so discarded on the way out
+    extractor.setSupportedMediaTypes(YouTubeExtractor::AudioMp4);
+
+    extractor.setAudioOnly(false);
+    QCOMPARE(extractor.preferredVideoQualities(), qualities);
+    QCOMPARE(extractor.supportedMediaTypes(), YouTubeExtractor::MediaTypes(YouTubeExtractor::VideoMp4));
+}
+
+void tst_AudioBandwidth::sharedCacheKeepsModesApart()
+{
+    YouTubeSharedCache cache(QString("youtube-test-cache-%1").arg(QCoreApplication::applicationPid()));
+    if(!cache.isAttached())
+        QSKIP("Shared memory is not available here");
+
+    QObject owner;
+    const int requests = m_videoInfoRequests;
+
+    YouTubeExtractor *video = createExtractor(&owner);
+    video->setSharedCache(&cache);
+    QVERIFY(extract(video));
+    QCOMPARE(m_videoInfoRequests, requests + 1);
+
+    // The same filters are answered from the cache
+    YouTubeExtractor *sameFilters = createExtractor(&owner);
+    sameFilters->setSharedCache(&cache);
+    QVERIFY(extract(sameFilters));
+    QCOMPARE(m_videoInfoRequests, requests + 1);
+    QCOMPARE(sameFilters->videoUrl(YouTubeExtractor::Any), video->videoUrl(YouTubeExtractor::Any));
+
+    // Audio-only mode filters differently, so the video entry must not be used
+    YouTubeExtractor *audio = createExtractor(&owner);
+    audio->setAudioOnly(true);
+    audio->setSharedCache(&cache);
+    QVERIFY(extract(audio));
+    QCOMPARE(m_videoInfoRequests, requests + 2);
+    QVERIFY(audio->videoUrl(YouTubeExtractor::Any).isEmpty());
+    QVERIFY(!audio->audioUrl().isEmpty());
+}
+
+void tst_AudioBandwidth::stalledAudio()
+{
+    QObject owner;
+
+    YouTubeExtractor *audio = createExtractor(&owner);
+    audio->setVideoInfoUrl(m_server.url("/stalled_video_info"));
+    audio->setAudioOnly(true);
+    QVERIFY(extract(audio));
+
+    // The timeout limits the wait between chunks, not the whole stream
+    audio->setTimeout(500);
+
+    QBuffer track;
+    QVERIFY(track.open(QIODevice::WriteOnly));
+    QSignalSpy audioSpy(audio, SIGNAL(audioReady(YouTubeExtractorError)));
+    audio->streamAudio(&track);
+    QVERIFY(audioSpy.wait(10000));
+
+    QCOMPARE(audioSpy.first().first().value<YouTubeExtractorError>().code(), YouTubeExtractorError::TimeoutError);
+    QCOMPARE(audio->timedOutCount(), 1);
+    QCOMPARE(audio->audioBytesReceived(), qint64(1024));
+    QCOMPARE(track.size(), qint64(1024));
+    QVERIFY(!audio->isRunning());
+}
+
+YouTubeExtractor *tst_AudioBandwidth::createExtractor(QObject *parent)
+{
+    YouTubeExtractor *extractor = new YouTubeExtractor(QString("replayed01"), parent);
+    extractor->setVideoInfoUrl(m_server.url("/get_video_info"));
+    extractor->setTimeout(30000);
+
+    return extractor;
+}
+
+bool tst_AudioBandwidth::extract(YouTubeExtractor *extractor)
+{
+    // Results from the cache still arrive through the event loop
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+
+    return (!spy.isEmpty() || spy.wait(10000)) && !extractor->lastError().isValid();
+}
+
+QTEST_GUILESS_MAIN(tst_AudioBandwidth)
+
+#include "tst_audiobandwidth.moc"
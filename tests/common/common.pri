@@ -0,0 +1,7 @@
+# Local HTTP server the network tests run against
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/replayserver.cpp
+
+HEADERS += $$PWD/replayserver.h
@@ -0,0 +1,189 @@
+#include "replayserver.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+
+static QByteArray reasonPhrase(int status)
+{
+    switch(status)
+    {
+    case 200:
+        return "OK";
+    case 304:
+        return "Not Modified";
+    case 404:
+        return "Not Found";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Unknown";
+    }
+}
+
+static QByteArray streamMap(const QList<ReplayStream> &streams)
+{
+    QList<QByteArray> records;
+    foreach(const ReplayStream &stream, streams)
+    {
+        records << "itag=" + QByteArray::number(stream.itag)
+                   + "&type=" + QUrl::toPercentEncoding(stream.type)
+                   + "&url=" + QUrl::toPercentEncoding(stream.url.toEncoded())
+                   + "&sig=replay";
+    }
+
+    // Records are encoded once more as a whole, commas included
+    return QUrl::toPercentEncoding(records.join(','));
+}
+
+QByteArray replayVideoInfo(const QString &title,
+                           const QList<ReplayStream> &streams,
+                           const QList<ReplayStream> &adaptiveStreams,
+                           const QHash<QString, QUrl> &thumbnails)
+{
+    QByteArray response = "status=ok&title=" + QUrl::toPercentEncoding(title);
+
+    for(QHash<QString, QUrl>::const_iterator it = thumbnails.constBegin(); it != thumbnails.constEnd(); ++it)
+        response += '&' + it.key().toUtf8() + '=' + QUrl::toPercentEncoding(it.value().toEncoded());
+
+    if(!streams.isEmpty())
+        response += "&url_encoded_fmt_stream_map=" + streamMap(streams);
+    if(!adaptiveStreams.isEmpty())
+        response += "&adaptive_fmts=" + streamMap(adaptiveStreams);
+
+    return response;
+}
+
+ReplayServer::ReplayServer(QObject *parent) :
+    QTcpServer(parent),
+    m_requestCount(0),
+    m_bytesSent(0)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+bool ReplayServer::start()
+{
+    return listen(QHostAddress::LocalHost);
+}
+
+QUrl ReplayServer::url(const QString &path) const
+{
+    return QUrl("http://127.0.0.1:" + QString::number(serverPort()) + path);
+}
+
+void ReplayServer::addHandler(const QByteArray &pathPrefix, const Handler &handler)
+{
+    m_handlers.append(qMakePair(pathPrefix, handler));
+}
+
+void ReplayServer::addResponse(const QByteArray &path, const ReplayResponse &response)
+{
+    addHandler(path, [response](const ReplayRequest &) { return response; });
+}
+
+int ReplayServer::requestCount() const
+{
+    return m_requestCount;
+}
+
+qint64 ReplayServer::bytesSent() const
+{
+    return m_bytesSent;
+}
+
+void ReplayServer::onNewConnection()
+{
+    while(hasPendingConnections())
+    {
+        QTcpSocket *socket = nextPendingConnection();
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void ReplayServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket || !m_buffers.contains(socket))
+        return;
+
+    // Several requests may arrive back to back on a kept-alive connection
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+    while(handleRequest(socket, buffer))
+        ;
+}
+
+void ReplayServer::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if(!socket)
+        return;
+
+    m_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+bool ReplayServer::handleRequest(QTcpSocket *socket, QByteArray &buffer)
+{
+    // GET requests have no body, so the head is all there is
+    const int end = buffer.indexOf("\r\n\r\n");
+    if(end < 0)
+        return false;
+
+    const QList<QByteArray> lines = buffer.left(end).split('\n');
+    buffer.remove(0, end + 4);
+
+    ReplayRequest request;
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    request.method = requestLine.value(0);
+    request.path = requestLine.value(1);
+    request.url = url(QString::fromLatin1(request.path));
+
+    for(int i = 1; i < lines.count(); ++i)
+    {
+        const int colon = lines.at(i).indexOf(':');
+        if(colon > 0)
+            request.headers.insert(lines.at(i).left(colon).trimmed().toLower(), lines.at(i).mid(colon + 1).trimmed());
+    }
+
+    ++m_requestCount;
+    const ReplayResponse response = respond(request);
+    if(response.status == 0)
+        return true;
+
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(response.status) + ' ' + reasonPhrase(response.status) + "\r\n";
+    for(int i = 0; i < response.headers.count(); ++i)
+        head += response.headers.at(i).first + ": " + response.headers.at(i).second + "\r\n";
+
+    // A 304 carries no body
+    if(response.status != 304)
+        head += "Content-Length: " + QByteArray::number(response.contentLength >= 0
+                                                        ? response.contentLength : response.body.size()) + "\r\n";
+    head += "Connection: keep-alive\r\n\r\n";
+
+    socket->write(head);
+    if(response.status != 304)
+    {
+        socket->write(response.body);
+        m_bytesSent += response.body.size();
+    }
+
+    return true;
+}
+
+ReplayResponse ReplayServer::respond(const ReplayRequest &request)
+{
+    if(request.method != "GET")
+        return ReplayResponse(404, "Only GET is served");
+
+    for(int i = 0; i < m_handlers.count(); ++i)
+    {
+        if(request.path.startsWith(m_handlers.at(i).first))
+            return m_handlers.at(i).second(request);
+    }
+
+    return ReplayResponse(404, "Not found");
+}
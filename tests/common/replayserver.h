@@ -0,0 +1,85 @@
+#ifndef REPLAYSERVER_H
+#define REPLAYSERVER_H
+
+#include <QTcpServer>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QUrl>
+#include <functional>
+
+class QTcpSocket;
+
+struct ReplayRequest {
+    QByteArray method;
+    QByteArray path;
+    QUrl url;
+
+    // Header names are lower case
+    QHash<QByteArray, QByteArray> headers;
+};
+
+struct ReplayStream {
+    int itag;
+    QByteArray type;
+    QUrl url;
+};
+
+// Encodes a get_video_info response the way the service does, with the stream
+// maps and thumbnails given; thumbnails are keyed by field, e.g. "iurlhq"
+QByteArray replayVideoInfo(const QString &title,
+                           const QList<ReplayStream> &streams,
+                           const QList<ReplayStream> &adaptiveStreams,
+                           const QHash<QString, QUrl> &thumbnails = QHash<QString, QUrl>());
+
+// A status of 0 leaves the request unanswered, as a stalled server would
+struct ReplayResponse {
+    ReplayResponse(int status = 200, const QByteArray &body = QByteArray()) :
+        status(status), body(body), contentLength(-1) {}
+
+    int status;
+    QByteArray body;
+
+    // Announced instead of the body size when set; a larger one leaves the
+    // client waiting for the rest
+    qint64 contentLength;
+    QList<QPair<QByteArray, QByteArray> > headers;
+};
+
+// Minimal HTTP/1.1 server on the loopback interface that answers GET requests
+// from canned or computed responses, so that tests never reach the real service.
+// Connections are kept alive, as QNetworkAccessManager expects.
+class ReplayServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    typedef std::function<ReplayResponse(const ReplayRequest &)> Handler;
+
+    explicit ReplayServer(QObject *parent = 0);
+
+    // Listens on a free port of 127.0.0.1
+    bool start();
+
+    QUrl url(const QString &path) const;
+
+    // Requests go to the first handler whose prefix starts their path
+    void addHandler(const QByteArray &pathPrefix, const Handler &handler);
+    void addResponse(const QByteArray &path, const ReplayResponse &response);
+
+    int requestCount() const;
+    qint64 bytesSent() const;
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+private:
+    QList<QPair<QByteArray, Handler> > m_handlers;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    int m_requestCount;
+    qint64 m_bytesSent;
+
+    bool handleRequest(QTcpSocket *socket, QByteArray &buffer);
+    ReplayResponse respond(const ReplayRequest &request);
+};
+
+#endif // REPLAYSERVER_H
@@ -0,0 +1,6 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+TARGET = tst_extractorbench
+
+SOURCES += tst_extractorbench.cpp
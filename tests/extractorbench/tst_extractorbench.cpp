@@ -0,0 +1,154 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubeextractor.h"
+#include "youtubevideometadata.h"
+
+class tst_ExtractorBench : public QObject
+{
+    Q_OBJECT
+private slots:
+    void construction_data();
+    void construction();
+    void isSupportedMedia_data();
+    void isSupportedMedia();
+    void isSupportedMediaWithCodecs_data();
+    void isSupportedMediaWithCodecs();
+    void codecsFromType();
+    void metadataFromMap();
+    void metadataLazy();
+};
+
+// "type" fields as get_video_info sends them, '+' for space included
+static void addTypes()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<bool>("supported");
+    QTest::addColumn<bool>("supportedAsH264");
+
+    QTest::newRow("18") << "video/mp4;+codecs=\"avc1.42001E,+mp4a.40.2\"" << true << true;
+    QTest::newRow("22") << "video/mp4;+codecs=\"avc1.64001F,+mp4a.40.2\"" << true << true;
+    QTest::newRow("36") << "video/3gpp;+codecs=\"mp4v.20.3,+mp4a.40.2\"" << true << false;
+    QTest::newRow("43") << "video/webm;+codecs=\"vp8.0,+vorbis\"" << true << false;
+    QTest::newRow("5") << "video/x-flv" << false << false;
+    QTest::newRow("137") << "video/mp4;+codecs=\"avc1.640028\"" << true << true;
+    QTest::newRow("248") << "video/webm;+codecs=\"vp9\"" << true << false;
+    QTest::newRow("398") << "video/mp4;+codecs=\"av01.0.05M.08\"" << true << false;
+    QTest::newRow("140") << "audio/mp4;+codecs=\"mp4a.40.2\"" << false << false;
+    QTest::newRow("251") << "audio/webm;+codecs=\"opus\"" << false << false;
+    QTest::newRow("unknown") << "application/octet-stream" << false << false;
+}
+
+// A get_video_info response with the fields an indexer reads and a typical
+// number of streams and fields it does not
+static QByteArray videoInfoResponse()
+{
+    QList<ReplayStream> streams;
+    QList<ReplayStream> adaptiveStreams;
+    const int itags[] = { 22, 43, 18, 36, 17, 137, 248, 136, 247, 135, 244, 134, 243, 133, 242, 140, 171, 249, 250, 251 };
+    for(int itag : itags)
+    {
+        const QUrl url("https://r1---sn-example.googlevideo.com/videoplayback?expire=1500000000&itag="
+                       + QString::number(itag) + "&sparams=dur,ei,id,ip,ipbits,itag,lmt,mime,mm,mn,ms,mv,pl,ratebypass");
+        (itag < 100 ? streams : adaptiveStreams) << ReplayStream{ itag, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"", url };
+    }
+
+    QByteArray response = replayVideoInfo("A benchmark video with a fairly long title", streams, adaptiveStreams);
+    response += "&author=Someone&length_seconds=212&view_count=123456"
+                "&keywords=one%2Ctwo%2Cthree%2Cfour%2Cfive"
+                "&caption_tracks=u%3Dhttps%253A%252F%252Fexample.com%252Fen%26lc%3Den%26n%3DEnglish";
+    for(int i = 0; i < 40; ++i)
+        response += "&unused_field_" + QByteArray::number(i) + "=" + QByteArray(64, 'x');
+
+    return response;
+}
+
+void tst_ExtractorBench::construction_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void tst_ExtractorBench::construction()
+{
+    QFETCH(int, count);
+
+    QBENCHMARK {
+        QObject owner;
+        for(int i = 0; i < count; ++i)
+            new YouTubeExtractor(QString("video%1").arg(i), &owner);
+    }
+}
+
+void tst_ExtractorBench::isSupportedMedia_data()
+{
+    addTypes();
+}
+
+void tst_ExtractorBench::isSupportedMedia()
+{
+    QFETCH(QString, type);
+    QFETCH(bool, supported);
+
+    YouTubeExtractor extractor;
+    QCOMPARE(extractor.isSupportedMedia(type), supported);
+
+    QBENCHMARK {
+        extractor.isSupportedMedia(type);
+    }
+}
+
+void tst_ExtractorBench::isSupportedMediaWithCodecs_data()
+{
+    addTypes();
+}
+
+void tst_ExtractorBench::isSupportedMediaWithCodecs()
+{
+    QFETCH(QString, type);
+    QFETCH(bool, supportedAsH264);
+
+    // Takes the path that parses the codecs parameter
+    YouTubeExtractor extractor;
+    extractor.setSupportedCodecs(YouTubeItag::H264 | YouTubeItag::Aac);
+    QCOMPARE(extractor.isSupportedMedia(type), supportedAsH264);
+
+    QBENCHMARK {
+        extractor.isSupportedMedia(type);
+    }
+}
+
+void tst_ExtractorBench::codecsFromType()
+{
+    const YouTubeExtractor::Codecs codecs = YouTubeExtractor::codecsFromType("video/webm;+codecs=\"vp9,+opus\"");
+    QCOMPARE(codecs, YouTubeItag::Vp9 | YouTubeItag::Opus);
+    QVERIFY(!YouTubeExtractor::codecsFromType("video/x-flv"));
+}
+
+void tst_ExtractorBench::metadataFromMap()
+{
+    // Every field is decoded, the stream maps included, to read a handful
+    const QString response = QString::fromUtf8(videoInfoResponse());
+
+    QBENCHMARK {
+        const QMap<QString, QString> fields = YouTubeExtractor::getMapFromQuery(response);
+        QVERIFY(!fields.value("title").isEmpty());
+    }
+}
+
+void tst_ExtractorBench::metadataLazy()
+{
+    // Only the fields that make up the JSON object are looked up and decoded
+    const QByteArray response = videoInfoResponse();
+
+    QBENCHMARK {
+        const YouTubeVideoMetadata metadata(QString("bench01"), response);
+        QVERIFY(!metadata.toJson().value("title").toString().isEmpty());
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_ExtractorBench)
+
+#include "tst_extractorbench.moc"
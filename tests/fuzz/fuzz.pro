@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+# A libFuzzer target to run by hand rather than part of "make check", e.g.
+#   ./fuzz_youtubeextractor -max_len=65536 corpus/
+CONFIG -= testcase
+QT -= testlib
+
+TARGET = fuzz_youtubeextractor
+
+QMAKE_CXXFLAGS += -fsanitize=fuzzer,address,undefined -fno-omit-frame-pointer
+QMAKE_LFLAGS += -fsanitize=fuzzer,address,undefined
+
+SOURCES += fuzz_youtubeextractor.cpp
@@ -0,0 +1,59 @@
+#include <QCoreApplication>
+#include <cstdint>
+#include "youtubeextractor.h"
+#include "youtubestreamparser.h"
+
+// libFuzzer entry points for the code that reads untrusted responses: the query
+// splitting and the get_video_info extraction, whole and fed in chunks
+
+static void discardMessages(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    static QCoreApplication app(*argc, *argv);
+    qInstallMessageHandler(discardMessages);
+
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // Copied so that reads past the end are caught rather than hitting a terminator
+    const QByteArray input(reinterpret_cast<const char *>(data), int(size));
+    const QString text = QString::fromUtf8(input);
+
+    YouTubeExtractor::getMapFromQuery(text);
+
+    static YouTubeExtractor extractor(QString("fuzz"));
+    if(extractor.extractFromResponse(text))
+    {
+        // Whatever was accepted has to be readable afterwards
+        extractor.videoUrl(YouTubeExtractor::Any);
+        extractor.audioUrl(YouTubeExtractor::BestAudio);
+        extractor.metadata().toJson();
+    }
+
+    // The first byte picks the chunk size, so that records split at every
+    // possible point are covered
+    if(size > 0)
+    {
+        const int chunkSize = 1 + data[0] % 64;
+        YouTubeStreamParser parser(4096);
+
+        for(int pos = 1; pos < input.size(); pos += chunkSize)
+        {
+            if(!parser.feed(input.mid(pos, chunkSize)))
+                break;
+
+            foreach(const QByteArray &query, parser.takeStreamQueries())
+                YouTubeExtractor::getMapFromQuery(query);
+        }
+
+        parser.finish();
+        parser.takeStreamQueries();
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTextStream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "youtubesharedcache.h"
+
+// Multi-process benchmark for YouTubeSharedCache. Worker processes all open the
+// same cache and look up keys drawn from a skewed distribution, inserting on a
+// miss the way an extractor would after a network round trip. The hit rate and
+// the latency of find() are reported over every worker together.
+
+const int PAYLOAD_SIZE = 2048;
+
+static int runWorker(const QStringList &arguments)
+{
+    const QString cacheKey = arguments.value(0);
+    const int capacity = arguments.value(1).toInt();
+    const int lookups = arguments.value(2).toInt();
+    const int keys = qMax(1, arguments.value(3).toInt());
+    const int seed = arguments.value(4).toInt();
+
+    YouTubeSharedCache cache(cacheKey, capacity);
+    if(!cache.isAttached())
+    {
+        qWarning("Worker %d: %s", seed, qPrintable(cache.errorString()));
+        return 1;
+    }
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const QByteArray payload(PAYLOAD_SIZE, 'x');
+    const qint64 expiresAt = QDateTime::currentMSecsSinceEpoch() / 1000 + 3600;
+
+    std::vector<qint64> latencies;
+    latencies.reserve(lookups);
+    int failedInserts = 0;
+    QByteArray found;
+    QElapsedTimer timer;
+
+    for(int i = 0; i < lookups; ++i)
+    {
+        // Squaring a uniform draw makes the low indices, the popular videos, far more likely
+        const double draw = uniform(random);
+        const QString key = QString("video%1:bench").arg(int(draw * draw * keys));
+
+        timer.start();
+        const bool hit = cache.find(key, &found);
+        latencies.push_back(timer.nsecsElapsed());
+
+        if(!hit && !cache.insert(key, payload, expiresAt))
+            ++failedInserts;
+    }
+
+    QTextStream out(stdout);
+    out << cache.hits() << ' ' << cache.misses() << ' ' << failedInserts << '\n';
+    for(qint64 latency : latencies)
+        out << latency << ' ';
+    out << '\n';
+
+    return 0;
+}
+
+static qint64 percentile(const std::vector<qint64> &sorted, double fraction)
+{
+    if(sorted.empty())
+        return 0;
+
+    return sorted[qMin<size_t>(sorted.size() - 1, size_t(fraction * sorted.size()))];
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QStringList arguments = app.arguments();
+    if(arguments.value(1) == "--worker")
+        return runWorker(arguments.mid(2));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures YouTubeSharedCache across several processes.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringList() << "p" << "processes", "Worker processes.", "count", "8"));
+    parser.addOption(QCommandLineOption(QStringList() << "n" << "lookups", "Lookups per worker.", "count", "20000"));
+    parser.addOption(QCommandLineOption(QStringList() << "k" << "keys", "Distinct video IDs.", "count", "512"));
+    parser.addOption(QCommandLineOption(QStringList() << "c" << "capacity", "Cache slots.", "count", "256"));
+    parser.process(app);
+
+    const int processes = qMax(1, parser.value("processes").toInt());
+    const int lookups = qMax(1, parser.value("lookups").toInt());
+    const int capacity = qMax(1, parser.value("capacity").toInt());
+
+    // Held by this process so that the segment stays alive while workers come and go
+    const QString cacheKey = QString("youtube-cache-bench-%1").arg(app.applicationPid());
+    YouTubeSharedCache cache(cacheKey, capacity);
+    if(!cache.isAttached())
+    {
+        qWarning("%s", qPrintable(cache.errorString()));
+        return 1;
+    }
+
+    QList<QProcess *> workers;
+    QElapsedTimer wallClock;
+    wallClock.start();
+
+    for(int i = 0; i < processes; ++i)
+    {
+        QProcess *worker = new QProcess(&app);
+        worker->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        worker->start(app.applicationFilePath(), QStringList() << "--worker" << cacheKey
+                      << QString::number(capacity) << QString::number(lookups)
+                      << parser.value("keys") << QString::number(i + 1));
+        workers.append(worker);
+    }
+
+    qint64 hits = 0;
+    qint64 misses = 0;
+    qint64 failedInserts = 0;
+    std::vector<qint64> latencies;
+
+    foreach(QProcess *worker, workers)
+    {
+        if(!worker->waitForFinished(-1) || worker->exitCode() != 0)
+        {
+            qWarning("A worker failed: %s", qPrintable(worker->errorString()));
+            return 1;
+        }
+
+        const QList<QByteArray> lines = worker->readAllStandardOutput().split('\n');
+        const QList<QByteArray> counters = lines.value(0).split(' ');
+        hits += counters.value(0).toLongLong();
+        misses += counters.value(1).toLongLong();
+        failedInserts += counters.value(2).toLongLong();
+
+        foreach(const QByteArray &latency, lines.value(1).split(' '))
+        {
+            if(!latency.isEmpty())
+                latencies.push_back(latency.toLongLong());
+        }
+    }
+
+    const qint64 elapsed = qMax<qint64>(1, wallClock.elapsed());
+    std::sort(latencies.begin(), latencies.end());
+
+    qint64 total = 0;
+    for(qint64 latency : latencies)
+        total += latency;
+
+    const qint64 lookupCount = hits + misses;
+    QTextStream out(stdout);
+    out << "processes:        " << processes << '\n'
+        << "lookups:          " << lookupCount << '\n'
+        << "hit rate:         " << (lookupCount ? 100.0 * hits / lookupCount : 0.0) << " %\n"
+        << "failed inserts:   " << failedInserts << '\n'
+        << "mean lookup:      " << (latencies.empty() ? 0 : total / qint64(latencies.size())) << " ns\n"
+        << "median lookup:    " << percentile(latencies, 0.5) << " ns\n"
+        << "99th percentile:  " << percentile(latencies, 0.99) << " ns\n"
+        << "slowest lookup:   " << (latencies.empty() ? 0 : latencies.back()) << " ns\n"
+        << "lookups / second: " << lookupCount * 1000 / elapsed << '\n';
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+# A benchmark to run by hand rather than part of "make check"
+CONFIG -= testcase
+QT -= testlib
+
+TARGET = sharedcachebench
+
+SOURCES += main.cpp
@@ -0,0 +1,155 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubeextractor.h"
+
+const int EXTRACTORS = 100;
+const int ROUNDS = 10;
+
+// Two thumbnails that succeed and one that fails on purpose, per round
+const int THUMBNAILS_PER_ROUND = 3;
+
+class tst_Stress : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void overlappingRequests();
+private:
+    ReplayServer m_server;
+};
+
+void tst_Stress::initTestCase()
+{
+    ReplayServer *server = &m_server;
+
+    // Every video gets stream URLs and thumbnails that name it, so that mixed up
+    // results show
+    m_server.addHandler("/get_video_info", [server](const ReplayRequest &request) {
+        const QString videoId = QUrlQuery(request.url).queryItemValue("video_id");
+
+        QList<ReplayStream> streams;
+        streams << ReplayStream{ 22, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"",
+                                 server->url("/videoplayback?id=" + videoId + "&itag=22") }
+                << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"",
+                                 server->url("/videoplayback?id=" + videoId + "&itag=18") };
+
+        QHash<QString, QUrl> thumbnails;
+        thumbnails.insert("iurl", server->url("/thumb/" + videoId + "/default.jpg"));
+        thumbnails.insert("iurlhq", server->url("/thumb/" + videoId + "/hq.jpg"));
+
+        return ReplayResponse(200, replayVideoInfo(videoId, streams, QList<ReplayStream>(), thumbnails));
+    });
+
+    // A thumbnail is its own path, which is easy to check
+    m_server.addHandler("/thumb/", [](const ReplayRequest &request) {
+        return ReplayResponse(200, request.path);
+    });
+
+    QVERIFY(m_server.start());
+}
+
+void tst_Stress::overlappingRequests()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QString failingPath = directory.path() + "/missing/thumbnail.jpg";
+
+    int finishedCount = 0;
+    int extractionErrors = 0;
+    int mismatchedResults = 0;
+    int thumbnailCount = 0;
+    int thumbnailErrors = 0;
+    int expectedThumbnailErrors = 0;
+    QVector<int> rounds(EXTRACTORS, 0);
+
+    QObject owner;
+    QList<YouTubeExtractor *> extractors;
+
+    for(int i = 0; i < EXTRACTORS; ++i)
+    {
+        YouTubeExtractor *extractor = new YouTubeExtractor(QString("video%1").arg(i), &owner);
+        extractor->setVideoInfoUrl(m_server.url("/get_video_info"));
+        extractor->setTimeout(30000);
+        extractors.append(extractor);
+
+        connect(extractor, &YouTubeExtractor::finished, [&, extractor, i]() {
+            ++finishedCount;
+            if(extractor->lastError().isValid())
+            {
+                ++extractionErrors;
+                return;
+            }
+
+            const QString streamUrl = extractor->videoUrl(YouTubeExtractor::MP4_720).toString();
+            if(!streamUrl.contains("id=" + extractor->videoId() + "&"))
+                ++mismatchedResults;
+
+            // The downloads overlap with each other and with the next extraction
+            const QString prefix = directory.path() + QString("/%1-%2").arg(i).arg(rounds[i]);
+            extractor->downloadThumbnail(prefix + "-default.jpg", YouTubeExtractor::Default);
+            extractor->downloadThumbnail(prefix + "-high.jpg", YouTubeExtractor::High);
+            extractor->downloadThumbnail(failingPath, YouTubeExtractor::Default);
+
+            if(++rounds[i] < ROUNDS)
+                extractor->start();
+        });
+
+        connect(extractor, &YouTubeExtractor::thumbnailReady,
+                [&, i](const QString &filePath, const YouTubeExtractorError &error) {
+            ++thumbnailCount;
+
+            if(filePath == failingPath)
+            {
+                if(error.code() == YouTubeExtractorError::FileError)
+                    ++expectedThumbnailErrors;
+                return;
+            }
+
+            if(error.isValid())
+            {
+                ++thumbnailErrors;
+                return;
+            }
+
+            QFile file(filePath);
+            const QByteArray expected = "/thumb/video" + QByteArray::number(i)
+                    + (filePath.endsWith("-high.jpg") ? "/hq.jpg" : "/default.jpg");
+            if(!file.open(QIODevice::ReadOnly) || file.readAll() != expected)
+                ++mismatchedResults;
+        });
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The first extraction of each is replaced straight away and must stay silent
+    foreach(YouTubeExtractor *extractor, extractors)
+    {
+        extractor->start();
+        extractor->start();
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(thumbnailCount, EXTRACTORS * ROUNDS * THUMBNAILS_PER_ROUND, 120000);
+    const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+
+    QCOMPARE(finishedCount, EXTRACTORS * ROUNDS);
+    QCOMPARE(extractionErrors, 0);
+    QCOMPARE(thumbnailErrors, 0);
+    QCOMPARE(mismatchedResults, 0);
+    QCOMPARE(expectedThumbnailErrors, EXTRACTORS * ROUNDS);
+
+    // A failed thumbnail is reported with it and leaves the extraction's error alone
+    foreach(YouTubeExtractor *extractor, extractors)
+    {
+        QVERIFY(!extractor->lastError().isValid());
+        QVERIFY(!extractor->isRunning());
+    }
+
+    const int requests = m_server.requestCount();
+    qDebug("%d extractions and %d thumbnails over %d requests in %lld ms: %lld requests/s",
+           finishedCount, thumbnailCount, requests, elapsed, requests * 1000 / elapsed);
+}
+
+QTEST_GUILESS_MAIN(tst_Stress)
+
+#include "tst_stress.moc"
@@ -0,0 +1,26 @@
+# Shared by every test: builds the extractor sources straight into the test binary
+
+QT       += core network testlib
+QT       -= gui
+
+CONFIG += c++14 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../youtubeextractor
+
+SOURCES += \
+    $$PWD/../youtubeextractor/youtubeextractor.cpp \
+    $$PWD/../youtubeextractor/youtubestreamparser.cpp \
+    $$PWD/../youtubeextractor/youtubesharedcache.cpp \
+    $$PWD/../youtubeextractor/youtubehlsplaylist.cpp \
+    $$PWD/../youtubeextractor/youtubevideometadata.cpp
+
+HEADERS += \
+    $$PWD/../youtubeextractor/youtubeextractor.h \
+    $$PWD/../youtubeextractor/youtubeitag.h \
+    $$PWD/../youtubeextractor/youtubestreamparser.h \
+    $$PWD/../youtubeextractor/youtubesharedcache.h \
+    $$PWD/../youtubeextractor/youtubehlsplaylist.h \
+    $$PWD/../youtubeextractor/youtubevideometadata.h
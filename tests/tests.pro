@@ -0,0 +1,16 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    youtubeitag \
+    youtubeextractor \
+    youtubestreamparser \
+    youtubesharedcache \
+    youtubevideometadata \
+    extractorbench \
+    sharedcachebench \
+    youtubehlsplaylist \
+    stress \
+    audiobandwidth
+
+# libFuzzer only comes with clang
+contains(QMAKE_COMPILER, clang): SUBDIRS += fuzz
@@ -0,0 +1,327 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubeextractor.h"
+#include "youtubesharedcache.h"
+
+// Long enough for a loopback round trip, short enough to keep the tests quick
+const int TIMEOUT = 300;
+
+class tst_YouTubeExtractor : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void timeout();
+    void deadline();
+    void abortExtraction();
+    void abortThumbnail();
+    void retryDropsFailedAttempt();
+    void stopAtFirstMatch();
+    void stopAtFirstMatchSkipsCache();
+    void livePath();
+    void livePathWithoutMp2t();
+    void liveFromCache();
+private:
+    ReplayServer m_server;
+
+    // Requests that reached any handler but the HLS manifest's
+    int m_requests;
+    int m_manifestRequests;
+
+    YouTubeExtractor *createExtractor(QObject *parent, const QString &path);
+};
+
+void tst_YouTubeExtractor::initTestCase()
+{
+    qRegisterMetaType<YouTubeExtractorError>();
+
+    int *requests = &m_requests;
+    ReplayServer *server = &m_server;
+
+    // Neither the video info nor the thumbnail is ever answered
+    m_server.addHandler("/stalled", [requests](const ReplayRequest &) {
+        ++*requests;
+        return ReplayResponse(0);
+    });
+
+    // The first "el" field fails after listing itag 22; the retry only has itag 18
+    m_server.addHandler("/retried", [server, requests](const ReplayRequest &request) {
+        ++*requests;
+
+        const bool firstAttempt = QUrlQuery(request.url).queryItemValue("el") == "embedded";
+        QList<ReplayStream> streams;
+        if(firstAttempt)
+            streams << ReplayStream{ 22, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"", server->url("/videoplayback?itag=22") };
+        else
+            streams << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", server->url("/videoplayback?itag=18") };
+
+        return ReplayResponse(firstAttempt ? 500 : 200,
+                              replayVideoInfo("Retried video", streams, QList<ReplayStream>()));
+    });
+
+    // The stream maps arrive, then the rest of the response never does
+    m_server.addHandler("/unfinished", [server, requests](const ReplayRequest &) {
+        ++*requests;
+
+        QList<ReplayStream> streams;
+        streams << ReplayStream{ 22, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"", server->url("/videoplayback?itag=22") }
+                << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", server->url("/videoplayback?itag=18") };
+
+        ReplayResponse response(200, replayVideoInfo("Unfinished video", streams, QList<ReplayStream>())
+                                + "&length_seconds=212");
+        response.contentLength = response.body.size() + 1024;
+
+        return response;
+    });
+
+    // A live broadcast lists no streams, only its HLS manifest
+    m_server.addHandler("/livevideo", [server, requests](const ReplayRequest &) {
+        ++*requests;
+        return ReplayResponse(200, "status=ok&title=Live&live_playback=1&hlsvp="
+                              + QUrl::toPercentEncoding(server->url("/hls/master.m3u8").toEncoded()));
+    });
+
+    int *manifestRequests = &m_manifestRequests;
+    m_server.addHandler("/hls/master.m3u8", [manifestRequests](const ReplayRequest &) {
+        ++*manifestRequests;
+        return ReplayResponse(200, "#EXTM3U\n"
+                                   "#EXT-X-STREAM-INF:BANDWIDTH=3256000,CODECS=\"avc1.4d401f,mp4a.40.2\",RESOLUTION=1280x720\n"
+                                   "itag/95/index.m3u8\n"
+                                   "#EXT-X-STREAM-INF:BANDWIDTH=5256000,CODECS=\"vp09.00.40.08,mp4a.40.2\",RESOLUTION=1920x1080\n"
+                                   "itag/96/index.m3u8\n");
+    });
+
+    QVERIFY(m_server.start());
+}
+
+void tst_YouTubeExtractor::init()
+{
+    m_requests = 0;
+    m_manifestRequests = 0;
+}
+
+void tst_YouTubeExtractor::timeout()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/stalled");
+    extractor->setTimeout(TIMEOUT);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QCOMPARE(extractor->lastError().code(), YouTubeExtractorError::TimeoutError);
+    QCOMPARE(extractor->timedOutCount(), 1);
+    QCOMPARE(extractor->cancelledCount(), 0);
+
+    // A request that timed out is not retried with the next "el" field
+    QTest::qWait(TIMEOUT);
+    QCOMPARE(m_requests, 1);
+    QVERIFY(!extractor->isRunning());
+}
+
+void tst_YouTubeExtractor::deadline()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/stalled");
+    extractor->setDeadline(TIMEOUT);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QCOMPARE(extractor->lastError().code(), YouTubeExtractorError::TimeoutError);
+    QCOMPARE(extractor->timedOutCount(), 1);
+}
+
+void tst_YouTubeExtractor::abortExtraction()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/stalled");
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QTRY_COMPARE(m_requests, 1);
+
+    extractor->abort();
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(extractor->lastError().code(), YouTubeExtractorError::CancelledError);
+    QCOMPARE(extractor->cancelledCount(), 1);
+    QCOMPARE(extractor->timedOutCount(), 0);
+
+    // abort() drops the remaining "el" fields, so nothing else goes out
+    QTest::qWait(TIMEOUT);
+    QCOMPARE(m_requests, 1);
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!extractor->isRunning());
+}
+
+void tst_YouTubeExtractor::abortThumbnail()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/stalled");
+
+    QHash<QString, QUrl> thumbnails;
+    thumbnails.insert("iurl", m_server.url("/stalled/default.jpg"));
+    QList<ReplayStream> streams;
+    streams << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", m_server.url("/videoplayback?itag=18") };
+    QVERIFY(extractor->extractFromResponse(replayVideoInfo("Stalled thumbnail", streams, QList<ReplayStream>(), thumbnails)));
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QString filePath = directory.path() + "/default.jpg";
+
+    QSignalSpy spy(extractor, SIGNAL(thumbnailReady(QString,YouTubeExtractorError)));
+    extractor->downloadThumbnail(filePath, YouTubeExtractor::Default);
+    QTRY_COMPARE(m_requests, 1);
+
+    extractor->abort();
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toString(), filePath);
+    QCOMPARE(spy.first().at(1).value<YouTubeExtractorError>().code(), YouTubeExtractorError::CancelledError);
+    QCOMPARE(extractor->cancelledCount(), 1);
+
+    // The download reports its own error and leaves the extraction's alone
+    QVERIFY(!extractor->lastError().isValid());
+    QVERIFY(!QFile::exists(filePath));
+}
+
+void tst_YouTubeExtractor::retryDropsFailedAttempt()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/retried");
+    extractor->setTimeout(TIMEOUT * 10);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QCOMPARE(m_requests, 2);
+    QVERIFY(!extractor->lastError().isValid());
+    QVERIFY(extractor->videoUrl(YouTubeExtractor::MP4_720).isEmpty());
+    QCOMPARE(QUrlQuery(extractor->videoUrl(YouTubeExtractor::Any)).queryItemValue("itag"), QString("18"));
+}
+
+void tst_YouTubeExtractor::stopAtFirstMatch()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/unfinished");
+    extractor->setStopAtFirstMatch(true);
+
+    // Only a reply aborted by the parser can finish here
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QVERIFY(!extractor->lastError().isValid());
+    QCOMPARE(QUrlQuery(extractor->videoUrl(YouTubeExtractor::Any)).queryItemValue("itag"), QString("22"));
+    QCOMPARE(extractor->cancelledCount(), 0);
+    QVERIFY(!extractor->isRunning());
+}
+
+void tst_YouTubeExtractor::stopAtFirstMatchSkipsCache()
+{
+    YouTubeSharedCache cache(QString("youtube-test-stop-%1").arg(QCoreApplication::applicationPid()));
+    if(!cache.isAttached())
+        QSKIP("Shared memory is not available here");
+
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/unfinished");
+    extractor->setStopAtFirstMatch(true);
+    extractor->setSharedCache(&cache);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+    QVERIFY(!extractor->lastError().isValid());
+
+    // The partial result was not published, so the next run asks the network again
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+    QCOMPARE(m_requests, 2);
+    QCOMPARE(cache.hits(), 0);
+    QCOMPARE(cache.misses(), 2);
+}
+
+void tst_YouTubeExtractor::livePath()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/livevideo");
+    extractor->setSupportedCodecs(YouTubeItag::H264 | YouTubeItag::Aac);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QVERIFY(!extractor->lastError().isValid());
+    QVERIFY(extractor->isLive());
+    QCOMPARE(extractor->hlsManifestUrl(), m_server.url("/hls/master.m3u8"));
+    QCOMPARE(m_manifestRequests, 1);
+
+    // Both variants are listed, but the VP9 one does not pass the codec filter
+    QCOMPARE(extractor->hlsVariants().count(), 2);
+    QCOMPARE(extractor->videoUrl(YouTubeExtractor::Any), m_server.url("/hls/itag/95/index.m3u8"));
+    QVERIFY(extractor->videoUrl(YouTubeExtractor::HLS_1080).isEmpty());
+}
+
+void tst_YouTubeExtractor::livePathWithoutMp2t()
+{
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/livevideo");
+    extractor->setSupportedMediaTypes(YouTubeExtractor::VideoMp4 | YouTubeExtractor::VideoWebm);
+
+    // Without HLS media the manifest is of no use, so it is not even fetched
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+
+    QVERIFY(extractor->isLive());
+    QCOMPARE(m_manifestRequests, 0);
+    QVERIFY(extractor->hlsVariants().isEmpty());
+    QVERIFY(extractor->videoUrl(YouTubeExtractor::Any).isEmpty());
+}
+
+void tst_YouTubeExtractor::liveFromCache()
+{
+    YouTubeSharedCache cache(QString("youtube-test-live-%1").arg(QCoreApplication::applicationPid()));
+    if(!cache.isAttached())
+        QSKIP("Shared memory is not available here");
+
+    QObject owner;
+    YouTubeExtractor *extractor = createExtractor(&owner, "/livevideo");
+    extractor->setSharedCache(&cache);
+
+    QSignalSpy spy(extractor, SIGNAL(finished()));
+    extractor->start();
+    QVERIFY(spy.wait(TIMEOUT * 10));
+    QVERIFY(!extractor->lastError().isValid());
+
+    YouTubeExtractor *cached = createExtractor(&owner, "/livevideo");
+    cached->setSharedCache(&cache);
+
+    QSignalSpy cachedSpy(cached, SIGNAL(finished()));
+    cached->start();
+    QVERIFY(cachedSpy.wait(TIMEOUT * 10));
+
+    // Everything but the metadata comes back, the variants included
+    QCOMPARE(m_requests, 1);
+    QCOMPARE(m_manifestRequests, 1);
+    QCOMPARE(cache.hits(), 1);
+    QVERIFY(cached->isLive());
+    QCOMPARE(cached->hlsVariants().count(), 2);
+    QCOMPARE(cached->hlsVariants().first().url, extractor->hlsVariants().first().url);
+    QCOMPARE(cached->videoUrl(YouTubeExtractor::Any), extractor->videoUrl(YouTubeExtractor::Any));
+}
+
+YouTubeExtractor *tst_YouTubeExtractor::createExtractor(QObject *parent, const QString &path)
+{
+    YouTubeExtractor *extractor = new YouTubeExtractor(QString("replayed01"), parent);
+    extractor->setVideoInfoUrl(m_server.url(path));
+
+    return extractor;
+}
+
+QTEST_GUILESS_MAIN(tst_YouTubeExtractor)
+
+#include "tst_youtubeextractor.moc"
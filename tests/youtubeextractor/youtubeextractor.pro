@@ -0,0 +1,6 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+TARGET = tst_youtubeextractor
+
+SOURCES += tst_youtubeextractor.cpp
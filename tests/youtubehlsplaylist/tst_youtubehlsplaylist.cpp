@@ -0,0 +1,249 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubehlsplaylist.h"
+
+// The live window holds this many segments
+const int WINDOW_SIZE = 3;
+
+// The broadcast ends once the window starts here
+const int LAST_MEDIA_SEQUENCE = 4;
+
+static QByteArray mediaPlaylist(qint64 mediaSequence, bool ended, qint64 discontinuitySequence = 0)
+{
+    QByteArray playlist = "#EXTM3U\n"
+                          "#EXT-X-VERSION:3\n"
+                          "#EXT-X-TARGETDURATION:1\n";
+    playlist += "#EXT-X-MEDIA-SEQUENCE:" + QByteArray::number(mediaSequence) + "\n";
+    playlist += "#EXT-X-DISCONTINUITY-SEQUENCE:" + QByteArray::number(discontinuitySequence) + "\n";
+
+    for(qint64 sequence = mediaSequence; sequence < mediaSequence + WINDOW_SIZE; ++sequence)
+        playlist += "#EXTINF:1.000,\nsegment" + QByteArray::number(sequence) + ".ts\n";
+
+    if(ended)
+        playlist += "#EXT-X-ENDLIST\n";
+
+    return playlist;
+}
+
+static QList<qint64> sequences(const QList<YouTubeHlsSegment> &segments)
+{
+    QList<qint64> sequences;
+    foreach(const YouTubeHlsSegment &segment, segments)
+        sequences.append(segment.sequence);
+
+    return sequences;
+}
+
+class tst_YouTubeHlsPlaylist : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rollingPlaylist();
+    void unchangedPlaylist();
+    void mediaSequenceRegression();
+    void discontinuitySequenceRegression();
+    void variantMediaType();
+    void transientErrors();
+    void permanentError();
+    void masterPlaylist();
+};
+
+void tst_YouTubeHlsPlaylist::rollingPlaylist()
+{
+    // Each window is served once, then answered with a 304 that moves it on
+    int mediaSequence = 0;
+    int notModifiedCount = 0;
+
+    ReplayServer server;
+    server.addHandler("/live/index.m3u8", [&](const ReplayRequest &request) {
+        const QByteArray etag = '"' + QByteArray::number(mediaSequence) + '"';
+
+        if(request.headers.value("if-none-match") == etag)
+        {
+            ++notModifiedCount;
+            if(mediaSequence < LAST_MEDIA_SEQUENCE)
+                ++mediaSequence;
+
+            ReplayResponse response(304);
+            response.headers << qMakePair(QByteArray("ETag"), etag);
+            return response;
+        }
+
+        ReplayResponse response(200, mediaPlaylist(mediaSequence, mediaSequence == LAST_MEDIA_SEQUENCE));
+        response.headers << qMakePair(QByteArray("ETag"), etag);
+        return response;
+    });
+    QVERIFY(server.start());
+
+    YouTubeHlsPlaylist playlist(server.url("/live/index.m3u8"));
+
+    QList<QList<qint64> > batches;
+    QList<QUrl> urls;
+    connect(&playlist, &YouTubeHlsPlaylist::segmentsReady, [&](const QList<YouTubeHlsSegment> &segments) {
+        batches.append(sequences(segments));
+        foreach(const YouTubeHlsSegment &segment, segments)
+            urls.append(segment.url);
+    });
+
+    QSignalSpy finishedSpy(&playlist, SIGNAL(finished()));
+    playlist.start();
+    QVERIFY(finishedSpy.wait(30000));
+
+    QVERIFY(!playlist.lastError().isValid());
+    QVERIFY(playlist.isEnded());
+    QCOMPARE(notModifiedCount, LAST_MEDIA_SEQUENCE);
+
+    // The first window in full, then only what each new window added
+    QList<QList<qint64> > expected;
+    expected << (QList<qint64>() << 0 << 1 << 2);
+    for(qint64 sequence = WINDOW_SIZE; sequence < LAST_MEDIA_SEQUENCE + WINDOW_SIZE; ++sequence)
+        expected << (QList<qint64>() << sequence);
+    QCOMPARE(batches, expected);
+
+    QCOMPARE(urls.count(), LAST_MEDIA_SEQUENCE + WINDOW_SIZE);
+    QCOMPARE(urls.last(), server.url("/live/segment6.ts"));
+    QCOMPARE(playlist.lastSequence(), qint64(LAST_MEDIA_SEQUENCE + WINDOW_SIZE - 1));
+}
+
+void tst_YouTubeHlsPlaylist::unchangedPlaylist()
+{
+    YouTubeHlsPlaylist playlist(QUrl("http://127.0.0.1/live/index.m3u8"));
+
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(10, false))), QList<qint64>() << 10 << 11 << 12);
+    QVERIFY(playlist.update(mediaPlaylist(10, false)).isEmpty());
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(11, false))), QList<qint64>() << 13);
+}
+
+void tst_YouTubeHlsPlaylist::mediaSequenceRegression()
+{
+    YouTubeHlsPlaylist playlist(QUrl("http://127.0.0.1/live/index.m3u8"));
+
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(100, false))), QList<qint64>() << 100 << 101 << 102);
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(101, false))), QList<qint64>() << 103);
+
+    // The encoder restarted and numbers its segments from zero again
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(0, false))), QList<qint64>() << 0 << 1 << 2);
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(1, false))), QList<qint64>() << 3);
+    QCOMPARE(playlist.lastSequence(), qint64(3));
+}
+
+void tst_YouTubeHlsPlaylist::discontinuitySequenceRegression()
+{
+    YouTubeHlsPlaylist playlist(QUrl("http://127.0.0.1/live/index.m3u8"));
+
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(20, false, 5))), QList<qint64>() << 20 << 21 << 22);
+    QVERIFY(playlist.update(mediaPlaylist(20, false, 5)).isEmpty());
+
+    // Same media sequence, but the discontinuity count went back: a new stream
+    QCOMPARE(sequences(playlist.update(mediaPlaylist(20, false, 0))), QList<qint64>() << 20 << 21 << 22);
+}
+
+void tst_YouTubeHlsPlaylist::variantMediaType()
+{
+    QCOMPARE(YouTubeExtractor::mediaTypeFromName("video/mp2t"), YouTubeExtractor::VideoMp2t);
+    QCOMPARE(YouTubeExtractor::mediaTypeFromName("application/vnd.apple.mpegurl"), YouTubeExtractor::VideoMp2t);
+
+    // HLS variants are muxed, so audio-only mode leaves them out
+    YouTubeExtractor extractor;
+    QVERIFY(extractor.supportedMediaTypes() & YouTubeExtractor::VideoMp2t);
+    extractor.setAudioOnly(true);
+    QVERIFY(!(extractor.supportedMediaTypes() & YouTubeExtractor::VideoMp2t));
+}
+
+void tst_YouTubeHlsPlaylist::transientErrors()
+{
+    // A server error and a stalled reload come between two windows
+    int requests = 0;
+
+    ReplayServer server;
+    server.addHandler("/live/index.m3u8", [&](const ReplayRequest &) {
+        switch(requests++)
+        {
+        case 0:
+            return ReplayResponse(200, mediaPlaylist(0, false));
+        case 1:
+            return ReplayResponse(503);
+        case 2:
+            return ReplayResponse(0);
+        default:
+            return ReplayResponse(200, mediaPlaylist(1, true));
+        }
+    });
+    QVERIFY(server.start());
+
+    YouTubeHlsPlaylist playlist(server.url("/live/index.m3u8"));
+    playlist.setTimeout(500);
+
+    QList<QList<qint64> > batches;
+    connect(&playlist, &YouTubeHlsPlaylist::segmentsReady, [&](const QList<YouTubeHlsSegment> &segments) {
+        batches.append(sequences(segments));
+    });
+
+    QSignalSpy finishedSpy(&playlist, SIGNAL(finished()));
+    playlist.start();
+    QVERIFY(finishedSpy.wait(30000));
+
+    QVERIFY(!playlist.lastError().isValid());
+    QVERIFY(playlist.isEnded());
+    QCOMPARE(requests, 4);
+    QCOMPARE(batches, QList<QList<qint64> >() << (QList<qint64>() << 0 << 1 << 2) << (QList<qint64>() << 3));
+}
+
+void tst_YouTubeHlsPlaylist::permanentError()
+{
+    int requests = 0;
+
+    ReplayServer server;
+    server.addHandler("/live/index.m3u8", [&](const ReplayRequest &) {
+        ++requests;
+        return ReplayResponse(404);
+    });
+    QVERIFY(server.start());
+
+    YouTubeHlsPlaylist playlist(server.url("/live/index.m3u8"));
+
+    // A playlist that is gone is not retried
+    QSignalSpy finishedSpy(&playlist, SIGNAL(finished()));
+    playlist.start();
+    QVERIFY(finishedSpy.wait(10000));
+
+    QCOMPARE(playlist.lastError().code(), YouTubeExtractorError::NetworkError);
+    QTest::qWait(1000);
+    QCOMPARE(requests, 1);
+    QCOMPARE(finishedSpy.count(), 1);
+}
+
+void tst_YouTubeHlsPlaylist::masterPlaylist()
+{
+    const QByteArray master =
+            "#EXTM3U\n"
+            "#EXT-X-STREAM-INF:BANDWIDTH=3256000,CODECS=\"avc1.4d401f,mp4a.40.2\",RESOLUTION=1280x720\n"
+            "https://manifest.example/api/itag/95/playlist/index.m3u8\n"
+            "#EXT-X-STREAM-INF:BANDWIDTH=298000,CODECS=\"avc1.4d4015,mp4a.40.2\",RESOLUTION=426x240\n"
+            "low/index.m3u8\n"
+            "#EXT-X-STREAM-INF:BANDWIDTH=90000,RESOLUTION=100x75\n"
+            "tiny/index.m3u8\n";
+
+    const QList<YouTubeHlsVariant> variants =
+            YouTubeHlsPlaylist::parseMasterPlaylist(master, QUrl("https://manifest.example/live/master.m3u8"));
+    QCOMPARE(variants.count(), 3);
+
+    // The itag in the path wins
+    QCOMPARE(variants.at(0).itag, 95);
+    QCOMPARE(variants.at(0).bandwidth, 3256000);
+    QCOMPARE(variants.at(0).width, 1280);
+    QCOMPARE(variants.at(0).height, 720);
+    QCOMPARE(variants.at(0).codecs, QString("avc1.4d401f,mp4a.40.2"));
+
+    // Otherwise the first HLS itag of that height, with the URL resolved
+    QCOMPARE(variants.at(1).itag, 92);
+    QCOMPARE(variants.at(1).url, QUrl("https://manifest.example/live/low/index.m3u8"));
+
+    // No HLS itag is that small
+    QCOMPARE(variants.at(2).itag, 0);
+    QVERIFY(variants.at(2).codecs.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(tst_YouTubeHlsPlaylist)
+
+#include "tst_youtubehlsplaylist.moc"
@@ -0,0 +1,307 @@
+#include <QtTest>
+#include "youtubeitag.h"
+#include "youtubeextractor.h"
+
+struct ExpectedItag {
+    int itag;
+    const char *container;
+    const char *videoCodec;
+    const char *audioCodec;
+    int height;
+    int fps;
+};
+
+// Taken from the published format lists rather than from youtubeitag.h, so that
+// a wrong entry in the registry is not also wrong here
+const ExpectedItag EXPECTED_ITAGS[] = {
+    // Itag Container Video   Audio     Height FPS
+    {   5, "flv",  "h263", "mp3",      240, 30 },
+    {   6, "flv",  "h263", "mp3",      270, 30 },
+    {  13, "3gp",  "mp4v", "aac",      144, 30 },
+    {  17, "3gp",  "mp4v", "aac",      144, 12 },
+    {  18, "mp4",  "h264", "aac",      360, 30 },
+    {  22, "mp4",  "h264", "aac",      720, 30 },
+    {  34, "flv",  "h264", "aac",      360, 30 },
+    {  35, "flv",  "h264", "aac",      480, 30 },
+    {  36, "3gp",  "mp4v", "aac",      240, 30 },
+    {  37, "mp4",  "h264", "aac",     1080, 30 },
+    {  38, "mp4",  "h264", "aac",     3072, 30 },
+    {  43, "webm", "vp8",  "vorbis",   360, 30 },
+    {  44, "webm", "vp8",  "vorbis",   480, 30 },
+    {  45, "webm", "vp8",  "vorbis",   720, 30 },
+    {  46, "webm", "vp8",  "vorbis",  1080, 30 },
+    {  59, "mp4",  "h264", "aac",      480, 30 },
+    {  78, "mp4",  "h264", "aac",      480, 30 },
+
+    // 3D
+    {  82, "mp4",  "h264", "aac",      360, 30 },
+    {  83, "mp4",  "h264", "aac",      480, 30 },
+    {  84, "mp4",  "h264", "aac",      720, 30 },
+    {  85, "mp4",  "h264", "aac",     1080, 30 },
+    { 100, "webm", "vp8",  "vorbis",   360, 30 },
+    { 101, "webm", "vp8",  "vorbis",   480, 30 },
+    { 102, "webm", "vp8",  "vorbis",   720, 30 },
+
+    // HLS, delivered as MPEG-TS segments
+    {  91, "ts",   "h264", "aac",      144, 30 },
+    {  92, "ts",   "h264", "aac",      240, 30 },
+    {  93, "ts",   "h264", "aac",      360, 30 },
+    {  94, "ts",   "h264", "aac",      480, 30 },
+    {  95, "ts",   "h264", "aac",      720, 30 },
+    {  96, "ts",   "h264", "aac",     1080, 30 },
+    { 132, "ts",   "h264", "aac",      240, 30 },
+    { 151, "ts",   "h264", "aac",       72, 30 },
+
+    // DASH video
+    { 133, "mp4",  "h264", "none",     240, 30 },
+    { 134, "mp4",  "h264", "none",     360, 30 },
+    { 135, "mp4",  "h264", "none",     480, 30 },
+    { 136, "mp4",  "h264", "none",     720, 30 },
+    { 137, "mp4",  "h264", "none",    1080, 30 },
+    { 138, "mp4",  "h264", "none",    2160, 30 },
+    { 160, "mp4",  "h264", "none",     144, 30 },
+    { 212, "mp4",  "h264", "none",     480, 30 },
+    { 264, "mp4",  "h264", "none",    1440, 30 },
+    { 266, "mp4",  "h264", "none",    2160, 30 },
+    { 298, "mp4",  "h264", "none",     720, 60 },
+    { 299, "mp4",  "h264", "none",    1080, 60 },
+    { 167, "webm", "vp8",  "none",     360, 30 },
+    { 168, "webm", "vp8",  "none",     480, 30 },
+    { 169, "webm", "vp8",  "none",     720, 30 },
+    { 170, "webm", "vp8",  "none",    1080, 30 },
+    { 218, "webm", "vp8",  "none",     480, 30 },
+    { 219, "webm", "vp8",  "none",     480, 30 },
+    { 242, "webm", "vp9",  "none",     240, 30 },
+    { 243, "webm", "vp9",  "none",     360, 30 },
+    { 244, "webm", "vp9",  "none",     480, 30 },
+    { 245, "webm", "vp9",  "none",     480, 30 },
+    { 246, "webm", "vp9",  "none",     480, 30 },
+    { 247, "webm", "vp9",  "none",     720, 30 },
+    { 248, "webm", "vp9",  "none",    1080, 30 },
+    { 271, "webm", "vp9",  "none",    1440, 30 },
+    { 272, "webm", "vp9",  "none",    2160, 30 },
+    { 278, "webm", "vp9",  "none",     144, 30 },
+    { 302, "webm", "vp9",  "none",     720, 60 },
+    { 303, "webm", "vp9",  "none",    1080, 60 },
+    { 308, "webm", "vp9",  "none",    1440, 60 },
+    { 313, "webm", "vp9",  "none",    2160, 30 },
+    { 315, "webm", "vp9",  "none",    2160, 60 },
+    { 394, "mp4",  "av1",  "none",     144, 30 },
+    { 395, "mp4",  "av1",  "none",     240, 30 },
+    { 396, "mp4",  "av1",  "none",     360, 30 },
+    { 397, "mp4",  "av1",  "none",     480, 30 },
+    { 398, "mp4",  "av1",  "none",     720, 30 },
+    { 399, "mp4",  "av1",  "none",    1080, 30 },
+
+    // DASH audio
+    { 139, "mp4",  "none", "aac",        0,  0 },
+    { 140, "mp4",  "none", "aac",        0,  0 },
+    { 141, "mp4",  "none", "aac",        0,  0 },
+    { 256, "mp4",  "none", "aac",        0,  0 },
+    { 258, "mp4",  "none", "aac",        0,  0 },
+    { 325, "mp4",  "none", "dtse",       0,  0 },
+    { 328, "mp4",  "none", "ec-3",       0,  0 },
+    { 171, "webm", "none", "vorbis",     0,  0 },
+    { 172, "webm", "none", "vorbis",     0,  0 },
+    { 249, "webm", "none", "opus",       0,  0 },
+    { 250, "webm", "none", "opus",       0,  0 },
+    { 251, "webm", "none", "opus",       0,  0 }
+};
+
+static QString containerName(YouTubeItag::Container container)
+{
+    switch(container)
+    {
+    case YouTubeItag::Flv:
+        return "flv";
+    case YouTubeItag::ThreeGp:
+        return "3gp";
+    case YouTubeItag::Mp4:
+        return "mp4";
+    case YouTubeItag::WebM:
+        return "webm";
+    case YouTubeItag::Ts:
+        return "ts";
+    default:
+        return "unknown";
+    }
+}
+
+static QString codecName(YouTubeItag::Codec codec)
+{
+    switch(codec)
+    {
+    case YouTubeItag::NoCodec:
+        return "none";
+    case YouTubeItag::H263:
+        return "h263";
+    case YouTubeItag::Mp4v:
+        return "mp4v";
+    case YouTubeItag::H264:
+        return "h264";
+    case YouTubeItag::Vp8:
+        return "vp8";
+    case YouTubeItag::Vp9:
+        return "vp9";
+    case YouTubeItag::Av1:
+        return "av1";
+    case YouTubeItag::Mp3:
+        return "mp3";
+    case YouTubeItag::Aac:
+        return "aac";
+    case YouTubeItag::Vorbis:
+        return "vorbis";
+    case YouTubeItag::Opus:
+        return "opus";
+    case YouTubeItag::Ec3:
+        return "ec-3";
+    case YouTubeItag::Dtse:
+        return "dtse";
+    default:
+        return "unknown";
+    }
+}
+
+class tst_YouTubeItag : public QObject
+{
+    Q_OBJECT
+private slots:
+    void entry_data();
+    void entry();
+    void coverage();
+    void unknownItags();
+    void qualityNames_data();
+    void qualityNames();
+    void deprecatedQualityNames();
+};
+
+void tst_YouTubeItag::entry_data()
+{
+    QTest::addColumn<int>("itag");
+    QTest::addColumn<QString>("container");
+    QTest::addColumn<QString>("videoCodec");
+    QTest::addColumn<QString>("audioCodec");
+    QTest::addColumn<int>("height");
+    QTest::addColumn<int>("fps");
+
+    for(const ExpectedItag &expected : EXPECTED_ITAGS)
+    {
+        QTest::newRow(QByteArray::number(expected.itag).constData())
+                << expected.itag << QString(expected.container)
+                << QString(expected.videoCodec) << QString(expected.audioCodec)
+                << expected.height << expected.fps;
+    }
+}
+
+void tst_YouTubeItag::entry()
+{
+    QFETCH(int, itag);
+    QFETCH(QString, container);
+    QFETCH(QString, videoCodec);
+    QFETCH(QString, audioCodec);
+    QFETCH(int, height);
+    QFETCH(int, fps);
+
+    const YouTubeItag &entry = YouTubeItag::find(itag);
+    QVERIFY(entry.isValid());
+    QCOMPARE(entry.itag, itag);
+    QCOMPARE(containerName(entry.container), container);
+    QCOMPARE(codecName(entry.videoCodec), videoCodec);
+    QCOMPARE(codecName(entry.audioCodec), audioCodec);
+    QCOMPARE(entry.height, height);
+    QCOMPARE(entry.fps, fps);
+
+    // Bitrates are typical values meant for ranking, so only their presence is checked
+    QVERIFY(entry.bitrate > 0);
+}
+
+void tst_YouTubeItag::coverage()
+{
+    // Every registry entry has to be checked by entry()
+    QSet<int> expected;
+    for(const ExpectedItag &entry : EXPECTED_ITAGS)
+        expected.insert(entry.itag);
+
+    for(const YouTubeItag &entry : YouTubeItags::Table)
+    {
+        if(!expected.contains(entry.itag))
+            QFAIL(qPrintable(QString("Itag %1 is not in the expected list").arg(entry.itag)));
+    }
+
+    QCOMPARE(YouTubeItags::Count, expected.count());
+}
+
+void tst_YouTubeItag::unknownItags()
+{
+    QVERIFY(!YouTubeItag::find(-1).isValid());
+    QVERIFY(!YouTubeItag::find(0).isValid());
+    QVERIFY(!YouTubeItag::find(1).isValid());
+    QVERIFY(!YouTubeItag::find(7).isValid());
+    QVERIFY(!YouTubeItag::find(YouTubeItags::MaxItag + 1).isValid());
+    QCOMPARE(YouTubeItag::find(7).kind(), YouTubeItag::InvalidKind);
+}
+
+void tst_YouTubeItag::qualityNames_data()
+{
+    // What each name promises: the container, and the height or the audio bitrate
+    QTest::addColumn<int>("quality");
+    QTest::addColumn<QString>("container");
+    QTest::addColumn<int>("figure");
+
+    QTest::newRow("Small") << int(YouTubeExtractor::Small) << "3gp" << 240;
+    QTest::newRow("Medium") << int(YouTubeExtractor::Medium) << "mp4" << 360;
+    QTest::newRow("FLV_240") << int(YouTubeExtractor::FLV_240) << "flv" << 240;
+    QTest::newRow("FLV_270") << int(YouTubeExtractor::FLV_270) << "flv" << 270;
+    QTest::newRow("_3GP_144_30FPS") << int(YouTubeExtractor::_3GP_144_30FPS) << "3gp" << 144;
+    QTest::newRow("_3GP_144") << int(YouTubeExtractor::_3GP_144) << "3gp" << 144;
+    QTest::newRow("MP4_720") << int(YouTubeExtractor::MP4_720) << "mp4" << 720;
+    QTest::newRow("FLV_H264_360") << int(YouTubeExtractor::FLV_H264_360) << "flv" << 360;
+    QTest::newRow("FLV_H264_480") << int(YouTubeExtractor::FLV_H264_480) << "flv" << 480;
+    QTest::newRow("MP4_1080") << int(YouTubeExtractor::MP4_1080) << "mp4" << 1080;
+    QTest::newRow("MP4_3072") << int(YouTubeExtractor::MP4_3072) << "mp4" << 3072;
+    QTest::newRow("WEBM_360") << int(YouTubeExtractor::WEBM_360) << "webm" << 360;
+    QTest::newRow("WEBM_720") << int(YouTubeExtractor::WEBM_720) << "webm" << 720;
+    QTest::newRow("HLS_144") << int(YouTubeExtractor::HLS_144) << "ts" << 144;
+    QTest::newRow("HLS_240") << int(YouTubeExtractor::HLS_240) << "ts" << 240;
+    QTest::newRow("HLS_360") << int(YouTubeExtractor::HLS_360) << "ts" << 360;
+    QTest::newRow("HLS_480") << int(YouTubeExtractor::HLS_480) << "ts" << 480;
+    QTest::newRow("HLS_720") << int(YouTubeExtractor::HLS_720) << "ts" << 720;
+    QTest::newRow("HLS_1080") << int(YouTubeExtractor::HLS_1080) << "ts" << 1080;
+    QTest::newRow("M4A_48") << int(YouTubeExtractor::M4A_48) << "mp4" << 48;
+    QTest::newRow("M4A_128") << int(YouTubeExtractor::M4A_128) << "mp4" << 128;
+    QTest::newRow("M4A_256") << int(YouTubeExtractor::M4A_256) << "mp4" << 256;
+    QTest::newRow("VORBIS_128") << int(YouTubeExtractor::VORBIS_128) << "webm" << 128;
+    QTest::newRow("VORBIS_256") << int(YouTubeExtractor::VORBIS_256) << "webm" << 256;
+    QTest::newRow("OPUS_50") << int(YouTubeExtractor::OPUS_50) << "webm" << 50;
+    QTest::newRow("OPUS_70") << int(YouTubeExtractor::OPUS_70) << "webm" << 70;
+    QTest::newRow("OPUS_160") << int(YouTubeExtractor::OPUS_160) << "webm" << 160;
+}
+
+void tst_YouTubeItag::qualityNames()
+{
+    QFETCH(int, quality);
+    QFETCH(QString, container);
+    QFETCH(int, figure);
+
+    const YouTubeItag &entry = YouTubeItag::find(quality);
+    QVERIFY(entry.isValid());
+    QCOMPARE(containerName(entry.container), container);
+    QCOMPARE(entry.hasVideo() ? entry.height : entry.bitrate, figure);
+}
+
+void tst_YouTubeItag::deprecatedQualityNames()
+{
+    // Kept as aliases so that existing code still builds
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+    QCOMPARE(int(YouTubeExtractor::FLV_360), int(YouTubeExtractor::FLV_240));
+    QCOMPARE(int(YouTubeExtractor::FLV_480), int(YouTubeExtractor::FLV_270));
+    QCOMPARE(int(YouTubeExtractor::_3GP_240), int(YouTubeExtractor::_3GP_144_30FPS));
+    QCOMPARE(int(YouTubeExtractor::MP4_360), int(YouTubeExtractor::FLV_H264_360));
+    QCOMPARE(int(YouTubeExtractor::MP4_480), int(YouTubeExtractor::FLV_H264_480));
+QT_WARNING_POP
+}
+
+QTEST_APPLESS_MAIN(tst_YouTubeItag)
+
+#include "tst_youtubeitag.moc"
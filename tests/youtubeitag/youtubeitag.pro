@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_youtubeitag
+
+SOURCES += tst_youtubeitag.cpp
@@ -0,0 +1,86 @@
+#include <QtTest>
+#include "youtubesharedcache.h"
+
+const int SLOT_SIZE = 4096;
+
+class tst_YouTubeSharedCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void roundTrip();
+    void smallerSegment();
+    void segmentTooSmall();
+private:
+    QString segmentKey(const char *name) const;
+};
+
+void tst_YouTubeSharedCache::roundTrip()
+{
+    YouTubeSharedCache cache(segmentKey("roundtrip"), 16, SLOT_SIZE);
+    if(!cache.isAttached())
+        QSKIP("Shared memory is not available here");
+
+    const qint64 expiresAt = QDateTime::currentMSecsSinceEpoch() / 1000 + 60;
+    QVERIFY(cache.insert("video01:0000", "payload", expiresAt));
+    QVERIFY(cache.insert("video02:0000", "expired", expiresAt - 120));
+
+    QByteArray payload;
+    QVERIFY(cache.find("video01:0000", &payload));
+    QCOMPARE(payload, QByteArray("payload"));
+    QVERIFY(!cache.find("video02:0000", &payload));
+    QVERIFY(!cache.find("video03:0000", &payload));
+    QCOMPARE(cache.hits(), 1);
+    QCOMPARE(cache.misses(), 2);
+
+    // A second handle on the same key sees the same table
+    YouTubeSharedCache other(segmentKey("roundtrip"), 16, SLOT_SIZE);
+    QVERIFY(other.isAttached());
+    QVERIFY(other.find("video01:0000", &payload));
+    QCOMPARE(payload, QByteArray("payload"));
+}
+
+void tst_YouTubeSharedCache::smallerSegment()
+{
+    // Created by someone else with room for fewer slots, and not laid out yet
+    QSharedMemory segment(segmentKey("smaller"));
+    if(!segment.create(16 * SLOT_SIZE))
+        QSKIP("Shared memory is not available here");
+
+    YouTubeSharedCache cache(segmentKey("smaller"), 256, SLOT_SIZE);
+    QVERIFY2(cache.isAttached(), qPrintable(cache.errorString()));
+    QVERIFY(cache.capacity() >= YouTubeSharedCache::ProbeLength);
+    QVERIFY(cache.capacity() * SLOT_SIZE <= segment.size());
+
+    const qint64 expiresAt = QDateTime::currentMSecsSinceEpoch() / 1000 + 60;
+    for(int i = 0; i < 64; ++i)
+        cache.insert(QString("video%1:0000").arg(i), QByteArray(cache.maxPayloadSize(), 'x'), expiresAt);
+
+    QByteArray payload;
+    QVERIFY(cache.insert("last:0000", "payload", expiresAt));
+    QVERIFY(cache.find("last:0000", &payload));
+    QCOMPARE(payload, QByteArray("payload"));
+}
+
+void tst_YouTubeSharedCache::segmentTooSmall()
+{
+    QSharedMemory segment(segmentKey("toosmall"));
+    if(!segment.create(SLOT_SIZE))
+        QSKIP("Shared memory is not available here");
+
+    YouTubeSharedCache cache(segmentKey("toosmall"), 256, SLOT_SIZE);
+    QVERIFY(!cache.isAttached());
+    QVERIFY(!cache.errorString().isEmpty());
+
+    QByteArray payload;
+    QVERIFY(!cache.insert("video01:0000", "payload", 0));
+    QVERIFY(!cache.find("video01:0000", &payload));
+}
+
+QString tst_YouTubeSharedCache::segmentKey(const char *name) const
+{
+    return QString("youtube-test-%1-%2").arg(name).arg(QCoreApplication::applicationPid());
+}
+
+QTEST_GUILESS_MAIN(tst_YouTubeSharedCache)
+
+#include "tst_youtubesharedcache.moc"
@@ -0,0 +1,5 @@
+include(../tests.pri)
+
+TARGET = tst_youtubesharedcache
+
+SOURCES += tst_youtubesharedcache.cpp
@@ -0,0 +1,169 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubestreamparser.h"
+
+// Small enough for the oversized cases, large enough for the stream map keys
+const int MAX_RECORD_SIZE = 32;
+
+struct ParseResult {
+    bool ok;
+    QList<QByteArray> records;
+    QByteArray rawFields;
+    QString errorString;
+};
+
+// Feeds the response in chunks of the given size, or whole when it is 0
+static ParseResult parse(const QByteArray &response, int chunkSize,
+                         int maxRecordSize = YouTubeStreamParser::DefaultMaxRecordSize)
+{
+    YouTubeStreamParser parser(maxRecordSize);
+    ParseResult result;
+    result.ok = true;
+
+    const int step = chunkSize > 0 ? chunkSize : qMax(1, response.size());
+    for(int pos = 0; pos < response.size() && result.ok; pos += step)
+    {
+        result.ok = parser.feed(response.mid(pos, step));
+        result.records << parser.takeStreamQueries();
+    }
+
+    if(result.ok)
+        result.ok = parser.finish();
+    result.records << parser.takeStreamQueries();
+    result.rawFields = parser.rawFields();
+    result.errorString = parser.errorString();
+
+    return result;
+}
+
+class tst_YouTubeStreamParser : public QObject
+{
+    Q_OBJECT
+private slots:
+    void wholeAndByteByByte();
+    void separatorAcrossChunks_data();
+    void separatorAcrossChunks();
+    void oversizedRecord_data();
+    void oversizedRecord();
+    void oversizedField_data();
+    void oversizedField();
+};
+
+void tst_YouTubeStreamParser::wholeAndByteByByte()
+{
+    QList<ReplayStream> streams;
+    streams << ReplayStream{ 22, "video/mp4; codecs=\"avc1.64001F, mp4a.40.2\"", QUrl("http://127.0.0.1/videoplayback?itag=22&expire=1") }
+            << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", QUrl("http://127.0.0.1/videoplayback?itag=18&expire=1") };
+
+    QList<ReplayStream> adaptiveStreams;
+    adaptiveStreams << ReplayStream{ 140, "audio/mp4; codecs=\"mp4a.40.2\"", QUrl("http://127.0.0.1/videoplayback?itag=140") };
+
+    QHash<QString, QUrl> thumbnails;
+    thumbnails.insert("iurl", QUrl("http://127.0.0.1/default.jpg"));
+
+    const QByteArray response = replayVideoInfo("Commas, ampersands & equals = signs", streams,
+                                                adaptiveStreams, thumbnails) + "&length_seconds=212";
+
+    const ParseResult whole = parse(response, 0);
+    QVERIFY(whole.ok);
+    QCOMPARE(whole.records.count(), streams.count() + adaptiveStreams.count());
+    QVERIFY(whole.records.first().startsWith("itag=22&"));
+    QVERIFY(whole.records.last().startsWith("itag=140&"));
+
+    // The stream maps never reach the other fields, which stay encoded
+    QVERIFY(whole.rawFields.startsWith("status=ok&title=Commas%2C"));
+    QVERIFY(whole.rawFields.endsWith("&length_seconds=212"));
+    QVERIFY(!whole.rawFields.contains("url_encoded_fmt_stream_map"));
+    QVERIFY(!whole.rawFields.contains("adaptive_fmts"));
+
+    const ParseResult byteByByte = parse(response, 1);
+    QVERIFY(byteByByte.ok);
+    QCOMPARE(byteByByte.records, whole.records);
+    QCOMPARE(byteByByte.rawFields, whole.rawFields);
+}
+
+void tst_YouTubeStreamParser::separatorAcrossChunks_data()
+{
+    QTest::addColumn<QByteArray>("separator");
+
+    QTest::newRow("upper case") << QByteArray("%2C");
+    QTest::newRow("lower case") << QByteArray("%2c");
+}
+
+void tst_YouTubeStreamParser::separatorAcrossChunks()
+{
+    QFETCH(QByteArray, separator);
+
+    const QByteArray response = "title=a&url_encoded_fmt_stream_map=itag%3D22" + separator
+            + "itag%3D18&status=ok";
+
+    QList<QByteArray> records;
+    records << "itag=22" << "itag=18";
+
+    // Every place the response can be cut in two, the separator included
+    for(int cut = 0; cut <= response.size(); ++cut)
+    {
+        YouTubeStreamParser parser;
+        QVERIFY(parser.feed(response.left(cut)));
+        QList<QByteArray> found = parser.takeStreamQueries();
+        QVERIFY(parser.feed(response.mid(cut)));
+        QVERIFY(parser.finish());
+        found << parser.takeStreamQueries();
+
+        QCOMPARE(found, records);
+        QCOMPARE(parser.rawFields(), QByteArray("title=a&status=ok"));
+    }
+}
+
+void tst_YouTubeStreamParser::oversizedRecord_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("whole") << 0;
+    QTest::newRow("byte by byte") << 1;
+    QTest::newRow("chunks") << 7;
+}
+
+void tst_YouTubeStreamParser::oversizedRecord()
+{
+    QFETCH(int, chunkSize);
+
+    const QByteArray response = "adaptive_fmts=itag%3D140%2C" + QByteArray(MAX_RECORD_SIZE * 2, 'x')
+            + "%2Citag%3D251&title=a";
+
+    const ParseResult result = parse(response, chunkSize, MAX_RECORD_SIZE);
+    QVERIFY(!result.ok);
+    QVERIFY(!result.errorString.isEmpty());
+
+    // Records completed before the oversized one are still handed out
+    QCOMPARE(result.records, QList<QByteArray>() << "itag=140");
+    QVERIFY(result.rawFields.isEmpty());
+}
+
+void tst_YouTubeStreamParser::oversizedField_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("whole") << 0;
+    QTest::newRow("byte by byte") << 1;
+    QTest::newRow("chunks") << 7;
+}
+
+void tst_YouTubeStreamParser::oversizedField()
+{
+    QFETCH(int, chunkSize);
+
+    const QByteArray response = "status=ok&keywords=" + QByteArray(MAX_RECORD_SIZE * 2, 'x')
+            + "&title=a&url_encoded_fmt_stream_map=itag%3D22";
+
+    // Fields the extractor does not need are dropped rather than failing it
+    const ParseResult result = parse(response, chunkSize, MAX_RECORD_SIZE);
+    QVERIFY(result.ok);
+    QVERIFY(result.errorString.isEmpty());
+    QCOMPARE(result.records, QList<QByteArray>() << "itag=22");
+    QCOMPARE(result.rawFields, QByteArray("status=ok&title=a"));
+}
+
+QTEST_GUILESS_MAIN(tst_YouTubeStreamParser)
+
+#include "tst_youtubestreamparser.moc"
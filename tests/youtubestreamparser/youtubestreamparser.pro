@@ -0,0 +1,6 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+TARGET = tst_youtubestreamparser
+
+SOURCES += tst_youtubestreamparser.cpp
@@ -0,0 +1,148 @@
+#include <QtTest>
+#include "replayserver.h"
+#include "youtubestreamparser.h"
+#include "youtubevideometadata.h"
+
+// Fields as get_video_info sends them: form encoded, lists joined by encoded commas
+const QByteArray QUERY = "status=ok"
+                         "&video_id=abc123"
+                         "&title=Lazy+%26+decoded%2C+100%25"
+                         "&author=Someone"
+                         "&length_seconds=212"
+                         "&view_count=9876543210"
+                         "&keywords=one%2Ctwo%2C%2Cthree+four%2C"
+                         "&caption_tracks=u%3Dhttps%253A%252F%252Fexample.com%252Fen%26lc%3Den%26n%3DEnglish"
+                         "%2Cu%3Dhttps%253A%252F%252Fexample.com%252Fde%26lc%3Dde%26n%3DDeutsch"
+                         "&id=outer";
+
+class tst_YouTubeVideoMetadata : public QObject
+{
+    Q_OBJECT
+private slots:
+    void lazyDecoding();
+    void missingFields();
+    void keywords();
+    void captionTracks();
+    void fromParser();
+    void exportNdjson();
+};
+
+void tst_YouTubeVideoMetadata::lazyDecoding()
+{
+    const YouTubeVideoMetadata metadata("abc123", QUERY);
+
+    // Nothing is decoded up front; the query is kept as it came
+    QVERIFY(!metadata.isEmpty());
+    QCOMPARE(metadata.rawQuery(), QUERY);
+    QCOMPARE(metadata.videoId(), QString("abc123"));
+
+    QCOMPARE(metadata.title(), QString("Lazy & decoded, 100%"));
+    QCOMPARE(metadata.title(), QString("Lazy & decoded, 100%"));
+    QCOMPARE(metadata.author(), QString("Someone"));
+    QCOMPARE(metadata.lengthSeconds(), 212);
+    QCOMPARE(metadata.viewCount(), Q_INT64_C(9876543210));
+
+    // Keys are matched at field boundaries only, not inside other keys
+    QCOMPARE(metadata.value("id"), QString("outer"));
+    QCOMPARE(metadata.value("video_id"), QString("abc123"));
+    QVERIFY(!metadata.contains("_id"));
+
+    // Copies share what they were built from
+    const YouTubeVideoMetadata copy = metadata;
+    QCOMPARE(copy.title(), metadata.title());
+    QCOMPARE(copy.rawQuery(), QUERY);
+}
+
+void tst_YouTubeVideoMetadata::missingFields()
+{
+    const YouTubeVideoMetadata metadata("abc123", QUERY);
+
+    QVERIFY(!metadata.contains("reason"));
+    QVERIFY(metadata.value("reason").isNull());
+
+    // Reading a missing field must not make it look present
+    QVERIFY(!metadata.contains("reason"));
+    QVERIFY(metadata.contains("title"));
+
+    const YouTubeVideoMetadata empty;
+    QVERIFY(empty.isEmpty());
+    QVERIFY(!empty.contains("title"));
+    QVERIFY(empty.title().isEmpty());
+    QVERIFY(empty.keywords().isEmpty());
+    QVERIFY(empty.captionTracks().isEmpty());
+}
+
+void tst_YouTubeVideoMetadata::keywords()
+{
+    const YouTubeVideoMetadata metadata("abc123", QUERY);
+
+    // Empty entries are left out
+    QCOMPARE(metadata.keywords(), QStringList() << "one" << "two" << "three four");
+}
+
+void tst_YouTubeVideoMetadata::captionTracks()
+{
+    const YouTubeVideoMetadata metadata("abc123", QUERY);
+    const QList<YouTubeCaptionTrack> tracks = metadata.captionTracks();
+
+    QCOMPARE(tracks.count(), 2);
+    QCOMPARE(tracks.at(0).languageCode, QString("en"));
+    QCOMPARE(tracks.at(0).name, QString("English"));
+    QCOMPARE(tracks.at(0).url, QUrl("https://example.com/en"));
+    QCOMPARE(tracks.at(1).languageCode, QString("de"));
+    QCOMPARE(tracks.at(1).name, QString("Deutsch"));
+    QCOMPARE(tracks.at(1).url, QUrl("https://example.com/de"));
+}
+
+void tst_YouTubeVideoMetadata::fromParser()
+{
+    QList<ReplayStream> streams;
+    streams << ReplayStream{ 18, "video/mp4; codecs=\"avc1.42001E, mp4a.40.2\"", QUrl("http://127.0.0.1/videoplayback?itag=18") };
+
+    YouTubeStreamParser parser;
+    QVERIFY(parser.feed(replayVideoInfo("Parsed title", streams, QList<ReplayStream>()) + "&author=Someone"));
+    QVERIFY(parser.finish());
+
+    // The stream maps never reach the metadata
+    const YouTubeVideoMetadata metadata("abc123", parser.rawFields());
+    QCOMPARE(metadata.title(), QString("Parsed title"));
+    QCOMPARE(metadata.author(), QString("Someone"));
+    QVERIFY(!metadata.contains("url_encoded_fmt_stream_map"));
+}
+
+void tst_YouTubeVideoMetadata::exportNdjson()
+{
+    QList<YouTubeVideoMetadata> metadata;
+    metadata << YouTubeVideoMetadata("abc123", QUERY)
+             << YouTubeVideoMetadata("def456", "title=Second&length_seconds=5");
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QCOMPARE(YouTubeVideoMetadata::exportNdjson(metadata, &buffer), qint64(2));
+
+    // One compact object per line
+    const QList<QByteArray> lines = buffer.data().split('\n');
+    QCOMPARE(lines.count(), 3);
+    QVERIFY(lines.last().isEmpty());
+
+    const QJsonObject first = QJsonDocument::fromJson(lines.at(0)).object();
+    QCOMPARE(first.value("videoId").toString(), QString("abc123"));
+    QCOMPARE(first.value("title").toString(), QString("Lazy & decoded, 100%"));
+    QCOMPARE(first.value("lengthSeconds").toInt(), 212);
+    QCOMPARE(first.value("viewCount").toDouble(), 9876543210.0);
+    QCOMPARE(first.value("keywords").toArray().count(), 3);
+    QCOMPARE(first.value("captionTracks").toArray().at(1).toObject().value("languageCode").toString(), QString("de"));
+
+    const QJsonObject second = QJsonDocument::fromJson(lines.at(1)).object();
+    QCOMPARE(second.value("videoId").toString(), QString("def456"));
+    QCOMPARE(second.value("title").toString(), QString("Second"));
+    QCOMPARE(second.value("keywords").toArray().count(), 0);
+
+    // A device that cannot be written to is refused
+    QBuffer closed;
+    QCOMPARE(YouTubeVideoMetadata::exportNdjson(metadata, &closed), qint64(-1));
+}
+
+QTEST_GUILESS_MAIN(tst_YouTubeVideoMetadata)
+
+#include "tst_youtubevideometadata.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+include(../common/common.pri)
+
+TARGET = tst_youtubevideometadata
+
+SOURCES += tst_youtubevideometadata.cpp
@@ -1,6 +1,11 @@
 #include "youtubeextractor.h"
+#include "youtubestreamparser.h"
+#include "youtubeitag.h"
+#include "youtubesharedcache.h"
+#include "youtubehlsplaylist.h"
 #include <QtNetwork>
 #include <QLocale>
+#include <algorithm>
 
 // First
 // /(?:youtube\\.com\\/\\S*(?:(?:\\/e(?:mbed))?\\/|watch\\/?\\?(?:\\S*?&?v\\=))|youtu\\.be\\/)([a-zA-Z0-9_-]{6,11})
@@ -12,28 +17,102 @@
 //const QString URL_PATTERN = "http(?:s?):\\/\\/(?:www\\.)(?:youtube\\.com\\/\\S*(?:(?:\\/e(?:mbed))?\\/|watch\\/?\\?(?:\\S*?&?v\\=))|youtu\\.be\\/)([a-zA-Z0-9_-]{6,11})";
 
 
-// Link used to fetch the RTSP URL; The %[number] are placeholders
-const QString FETCH_LINK = "https://www.youtube.com/get_video_info?video_id=%1%2&ps=default&eurl=&gl=US&hl=%3";
+// Link used to fetch the RTSP URL; the query is added by requestVideoInfo()
+const QString DEFAULT_VIDEO_INFO_URL = "https://www.youtube.com/get_video_info";
 
 // Works after "http:/", "https:/" and "www." is removed from the URL
 const QString URL_PATTERN = "/(?:youtube\\.com\\/\\S*(?:(?:\\/e(?:mbed))?\\/|watch\\/?\\?(?:\\S*?&?v\\=))|youtu\\.be\\/)([a-zA-Z0-9_-]{6,11})";
 
+// Where downloadThumbnail() requests keep their own file path
+const QNetworkRequest::Attribute FILE_PATH_ATTRIBUTE = QNetworkRequest::Attribute(QNetworkRequest::User + 1);
+
+// Lifetime of cached results whose stream URLs carry no "expire" field, in seconds
+const qint64 CACHE_TTL = 3600;
+
+// Cached results are dropped this many seconds before their stream URLs expire
+const qint64 CACHE_EXPIRY_MARGIN = 60;
+
+// Longest wait between two chunks of an audio stream when no timeout is set, in milliseconds
+const int AUDIO_INACTIVITY_TIMEOUT = 30000;
+
+// Tells the timer sendRequest() gives a reply apart from any the reply has itself
+const QString REQUEST_TIMER_NAME = "youtubeRequestTimer";
+
+struct MediaName {
+    const char *name;
+    YouTubeExtractor::MediaType type;
+};
+
+// The first name listed for a type is its canonical one
+const MediaName MEDIA_NAMES[] = {
+    { "video/mp4", YouTubeExtractor::VideoMp4 },
+    { "video/webm", YouTubeExtractor::VideoWebm },
+    { "video/3gpp", YouTubeExtractor::Video3gpp },
+    { "video/3gp", YouTubeExtractor::Video3gpp },
+    { "video/x-flv", YouTubeExtractor::VideoFlv },
+    { "video/flv", YouTubeExtractor::VideoFlv },
+    { "audio/mp4", YouTubeExtractor::AudioMp4 },
+    { "audio/m4a", YouTubeExtractor::AudioMp4 },
+    { "audio/webm", YouTubeExtractor::AudioWebm },
+    { "video/mp2t", YouTubeExtractor::VideoMp2t },
+    { "application/vnd.apple.mpegurl", YouTubeExtractor::VideoMp2t },
+    { "application/x-mpegurl", YouTubeExtractor::VideoMp2t }
+};
+
+struct CodecName {
+    const char *prefix;
+    YouTubeItag::Codec codec;
+};
+
+// Matched against the start of each entry of the "codecs" parameter
+const CodecName CODEC_NAMES[] = {
+    { "avc1", YouTubeItag::H264 },
+    { "avc3", YouTubeItag::H264 },
+    { "mp4v", YouTubeItag::Mp4v },
+    { "s263", YouTubeItag::H263 },
+    { "vp8", YouTubeItag::Vp8 },
+    { "vp9", YouTubeItag::Vp9 },
+    { "vp09", YouTubeItag::Vp9 },
+    { "av01", YouTubeItag::Av1 },
+    { "mp4a", YouTubeItag::Aac },
+    { "mp3", YouTubeItag::Mp3 },
+    { "vorbis", YouTubeItag::Vorbis },
+    { "opus", YouTubeItag::Opus },
+    { "ec-3", YouTubeItag::Ec3 },
+    { "dtse", YouTubeItag::Dtse }
+};
+
+// Variants are cached with the rest of a live result
+static QDataStream &operator<<(QDataStream &stream, const YouTubeHlsVariant &variant)
+{
+    return stream << variant.url << qint32(variant.itag) << qint32(variant.bandwidth)
+                  << qint32(variant.width) << qint32(variant.height) << variant.codecs;
+}
+
+static QDataStream &operator>>(QDataStream &stream, YouTubeHlsVariant &variant)
+{
+    qint32 itag, bandwidth, width, height;
+    stream >> variant.url >> itag >> bandwidth >> width >> height >> variant.codecs;
+
+    variant.itag = itag;
+    variant.bandwidth = bandwidth;
+    variant.width = width;
+    variant.height = height;
+
+    return stream;
+}
+
 YouTubeExtractor::YouTubeExtractor(QObject *parent) :
     QObject(parent)
 {
     setDefaults();
-    m_manager = new QNetworkAccessManager(this);
-    connect(m_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(onFinished(QNetworkReply*)));
 }
 
 YouTubeExtractor::YouTubeExtractor(const QString &videoId, QObject *parent) :
-    m_videoId(videoId),
-    QObject(parent)
+    QObject(parent),
+    m_videoId(videoId)
 {
     setDefaults();
-
-    m_manager = new QNetworkAccessManager(this);
-    connect(m_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(onFinished(QNetworkReply*)));
 }
 
 YouTubeExtractor::YouTubeExtractor(const QUrl &requestUrl, QObject *parent) :
@@ -41,34 +120,135 @@ YouTubeExtractor::YouTubeExtractor(const QUrl &requestUrl, QObject *parent) :
 {
     setRequestUrl(requestUrl);
     setDefaults();
+}
 
+void YouTubeExtractor::setDefaults()
+{
     m_manager = new QNetworkAccessManager(this);
     connect(m_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(onFinished(QNetworkReply*)));
+
+    m_elFieldIndex = 0;
+    m_stopAtFirstMatch = false;
+    m_audioOnly = false;
+    m_audioBytesReceived = 0;
+    m_live = false;
+    m_sharedCache = 0;
+    m_timeout = 0;
+    m_deadline = 0;
+    m_timedOutCount = 0;
+    m_cancelledCount = 0;
+
+    m_elFields << "embedded" << "detailpage" << "vevo" << "";
+
+    m_videoInfoUrl = QUrl(DEFAULT_VIDEO_INFO_URL);
+
+    m_supportedCodecs = YouTubeItag::AllCodecs;
+
+    setMediaDefaults();
 }
 
-void YouTubeExtractor::setDefaults()
+void YouTubeExtractor::setMediaDefaults()
 {
-    m_elFields << "embedded" << "detailpage" << "vevo" << "";
+    m_preferredVideoQualities.clear();
 
-    m_preferredVideoQualities << Small << Medium << FLV_360
-                              << FLV_480 << _3GP_240 <<_3GP_144
-                              << _3GP_144 << MP4_720 << MP4_360
-                              << MP4_480 << MP4_1080 << MP4_3072
-                              << WEBM_360 << WEBM_720;
+    if(m_audioOnly)
+    {
+        m_preferredVideoQualities << M4A_48 << M4A_128 << M4A_256
+                                  << VORBIS_128 << VORBIS_256
+                                  << OPUS_50 << OPUS_70 << OPUS_160;
+
+        m_supportedMediaTypes = AudioMp4 | AudioWebm;
+        return;
+    }
+
+    m_preferredVideoQualities << Small << Medium << FLV_240
+                              << FLV_270 << _3GP_144_30FPS << _3GP_144
+                              << MP4_720 << FLV_H264_360
+                              << FLV_H264_480 << MP4_1080 << MP4_3072
+                              << WEBM_360 << WEBM_720
+                              << HLS_144 << HLS_240 << HLS_360
+                              << HLS_480 << HLS_720 << HLS_1080;
 
-    m_supportedMedia << QMimeDatabase().mimeTypeForName("video/mp4")
-                     << QMimeDatabase().mimeTypeForName("video/webm")
-                     << QMimeDatabase().mimeTypeForName("video/3gp");
+    m_supportedMediaTypes = VideoMp4 | VideoWebm | Video3gpp | VideoMp2t;
 }
 
 void YouTubeExtractor::onFinished(QNetworkReply *reply)
 {
-    const Attribute attribute = (Attribute) reply->request().attribute(QNetworkRequest::User).toInt();
+    bool isAttribute = false;
+    const int attributeValue = reply->request().attribute(QNetworkRequest::User).toInt(&isAttribute);
+
+    m_replies.removeOne(reply);
+    reply->deleteLater();
+
+    // Replies aborted by onReadyRead() have already been dealt with by the parser
+    const QSharedPointer<YouTubeStreamParser> parser = m_parsers.take(reply);
+    const bool stoppedByParser = reply->property("stoppedByParser").toBool();
+    const QPointer<QIODevice> audioSink = m_audioSinks.take(reply);
+    const QString filePath = reply->request().attribute(FILE_PATH_ATTRIBUTE).toString();
+
+    // Replaced by a later start(), or not a request of ours
+    if(reply->property("superseded").toBool() || !isAttribute
+            || attributeValue < ExtractAttribute || attributeValue > AudioAttribute)
+        return;
+
+    const Attribute attribute = static_cast<Attribute>(attributeValue);
 
     try {
+        if(reply->property("writeFailed").toBool())
+        {
+            throw YouTubeExtractorException(YouTubeExtractorError::FileError,
+                                            tr("Unable to write the audio stream."));
+        }
+
+        // An aborted reply was either cancelled by the caller or hit a deadline
+        if(reply->error() == QNetworkReply::OperationCanceledError && !stoppedByParser)
+        {
+            if(reply->property("timedOut").toBool())
+            {
+                ++m_timedOutCount;
+                throw YouTubeExtractorException(YouTubeExtractorError::TimeoutError,
+                                                tr("The request timed out."));
+            }
+
+            ++m_cancelledCount;
+            throw YouTubeExtractorException(YouTubeExtractorError::CancelledError,
+                                            tr("The request was cancelled."));
+        }
+
         switch(attribute)
         {
         case ExtractAttribute:
+            if(reply->error() != QNetworkReply::NoError && !stoppedByParser)
+            {
+                throw YouTubeExtractorException(YouTubeExtractorError::NetworkError,
+                                                reply->errorString());
+            }
+            else
+            {
+                if(!stoppedByParser)
+                {
+                    parser->feed(reply->readAll());
+                    parser->finish();
+                }
+
+                completeExtraction(parser.data());
+
+                // Live broadcasts only list their streams in the HLS manifest
+                if(m_videoUrls.isEmpty() && !m_hlsManifestUrl.isEmpty()
+                        && (m_supportedMediaTypes & VideoMp2t))
+                {
+                    requestManifest();
+                    break;
+                }
+
+                // A parser stopped early leaves out the streams that came later
+                if(!stoppedByParser)
+                    storeInCache();
+
+                emit finished();
+            }
+            break;
+        case ManifestAttribute:
             if(reply->error() != QNetworkReply::NoError)
             {
                 throw YouTubeExtractorException(YouTubeExtractorError::NetworkError,
@@ -76,11 +256,35 @@ void YouTubeExtractor::onFinished(QNetworkReply *reply)
             }
             else
             {
-                const QByteArray response = reply->readAll();
-                extractFromReply(QString(response));
+                extractFromManifest(reply->readAll(), reply->url());
+                storeInCache();
                 emit finished();
             }
             break;
+        case AudioAttribute:
+            if(reply->error() != QNetworkReply::NoError)
+            {
+                throw YouTubeExtractorException(YouTubeExtractorError::NetworkError,
+                                                reply->errorString());
+            }
+            else
+            {
+                const QByteArray data = reply->readAll();
+                m_audioBytesReceived += data.size();
+
+                if(!audioSink || audioSink->write(data) != data.size())
+                {
+                    throw YouTubeExtractorException(YouTubeExtractorError::FileError,
+                                                    tr("Unable to write the audio stream."));
+                }
+
+                // Files opened by downloadAudio() belong to the reply
+                if(audioSink->parent() == reply)
+                    audioSink->close();
+
+                emit audioReady(YouTubeExtractorError());
+            }
+            break;
         case DownloadAttribute:
             if(reply->error() != QNetworkReply::NoError)
             {
@@ -89,27 +293,105 @@ void YouTubeExtractor::onFinished(QNetworkReply *reply)
             }
             else
             {
-                QFile file(m_thumbnailFilePath);
-                if(!file.open(QIODevice::WriteOnly))
+                QFile file(filePath);
+                if(!file.open(QIODevice::WriteOnly) || file.write(reply->readAll()) < 0)
                 {
                     throw YouTubeExtractorException(YouTubeExtractorError::FileError,
                                                     file.errorString());
                 }
 
-                emit thumbnailReady();
+                emit thumbnailReady(filePath, YouTubeExtractorError());
             }
             break;
         }
     }
     catch(YouTubeExtractorException &e)
     {
+        // Try the next "el" field before giving up, unless the request was aborted
+        if(attribute == ExtractAttribute
+                && e.code() != YouTubeExtractorError::TimeoutError
+                && e.code() != YouTubeExtractorError::CancelledError
+                && m_elFieldIndex + 1 < m_elFields.count())
+        {
+            // Streams found before the failure belong to the failed attempt
+            ++m_elFieldIndex;
+            clearResults();
+            requestVideoInfo();
+            return;
+        }
+
         qDebug() << "YouTubeExtractor:" << e.text();
-        setLastError(YouTubeExtractorError(e.code(), e.text()));
+        const YouTubeExtractorError error(e.code(), e.text());
 
-        if(attribute == ExtractAttribute)
+        // Downloads report their errors to whoever asked for them, so that
+        // lastError() keeps describing the extraction
+        if(attribute == ExtractAttribute || attribute == ManifestAttribute)
+        {
+            setLastError(error);
             emit finished();
+        }
         else if(attribute == DownloadAttribute)
-            emit thumbnailReady();
+            emit thumbnailReady(filePath, error);
+        else if(attribute == AudioAttribute)
+            emit audioReady(error);
+    }
+}
+
+void YouTubeExtractor::onReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if(!reply)
+        return;
+
+    const QSharedPointer<YouTubeStreamParser> parser = m_parsers.value(reply);
+    if(!parser)
+        return;
+
+    const bool ok = parser->feed(reply->readAll());
+    const bool matched = extractStreams(parser.data());
+
+    // Aborting finishes the reply right away, so it has to come last
+    if(!ok || (matched && m_stopAtFirstMatch))
+    {
+        reply->setProperty("stoppedByParser", true);
+        reply->abort();
+    }
+}
+
+void YouTubeExtractor::onAudioReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if(!reply || !m_audioSinks.contains(reply))
+        return;
+
+    // Written straight through, so nothing but the current chunk is held
+    const QPointer<QIODevice> device = m_audioSinks.value(reply);
+    const QByteArray data = reply->readAll();
+    m_audioBytesReceived += data.size();
+
+    // Only a stall counts against an audio stream
+    QTimer *timer = reply->findChild<QTimer *>(REQUEST_TIMER_NAME, Qt::FindDirectChildrenOnly);
+    if(timer)
+        timer->start();
+
+    if(!device || device->write(data) != data.size())
+    {
+        reply->setProperty("writeFailed", true);
+        reply->abort();
+    }
+}
+
+void YouTubeExtractor::onRequestTimeout()
+{
+    QTimer *timer = qobject_cast<QTimer *>(sender());
+    if(!timer)
+        return;
+
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(timer->parent());
+    if(reply && reply->isRunning())
+    {
+        reply->setProperty("timedOut", true);
+        reply->abort();
     }
 }
 
@@ -128,12 +410,102 @@ void YouTubeExtractor::setSupportedMedia(const QList<QMimeType> &mimes)
     if(mimes.isEmpty())
         return;
 
-    m_supportedMedia = mimes;
+    MediaTypes types;
+    foreach(const QMimeType &mime, mimes)
+    {
+        types |= mediaTypeFromName(mime.name());
+        foreach(const QString &alias, mime.aliases())
+            types |= mediaTypeFromName(alias);
+    }
+
+    m_supportedMediaTypes = types;
 }
 
 QList<QMimeType> YouTubeExtractor::supportedMedia() const
 {
-    return m_supportedMedia;
+    QMimeDatabase database;
+    QList<QMimeType> mimes;
+    MediaTypes listed;
+
+    for(const MediaName &media : MEDIA_NAMES)
+    {
+        if((m_supportedMediaTypes & media.type) && !(listed & media.type))
+        {
+            mimes << database.mimeTypeForName(media.name);
+            listed |= media.type;
+        }
+    }
+
+    return mimes;
+}
+
+YouTubeExtractor::MediaTypes YouTubeExtractor::supportedMediaTypes() const
+{
+    return m_supportedMediaTypes;
+}
+
+void YouTubeExtractor::setSupportedMediaTypes(MediaTypes types)
+{
+    m_supportedMediaTypes = types;
+}
+
+YouTubeExtractor::Codecs YouTubeExtractor::supportedCodecs() const
+{
+    return m_supportedCodecs;
+}
+
+void YouTubeExtractor::setSupportedCodecs(Codecs codecs)
+{
+    m_supportedCodecs = codecs & YouTubeItag::AllCodecs;
+}
+
+YouTubeSharedCache *YouTubeExtractor::sharedCache() const
+{
+    return m_sharedCache;
+}
+
+void YouTubeExtractor::setSharedCache(YouTubeSharedCache *cache)
+{
+    m_sharedCache = cache;
+}
+
+YouTubeExtractor::MediaType YouTubeExtractor::mediaTypeFromName(const QString &name)
+{
+    // Built once and shared by every extractor
+    static const QHash<QString, MediaType> types = []() {
+        QHash<QString, MediaType> types;
+        for(const MediaName &media : MEDIA_NAMES)
+            types.insert(QLatin1String(media.name), media.type);
+
+        return types;
+    }();
+
+    return types.value(name, NoMedia);
+}
+
+YouTubeExtractor::Codecs YouTubeExtractor::codecsFromType(const QString &type)
+{
+    // e.g. video/mp4;+codecs="avc1.42001E,+mp4a.40.2"
+    Codecs codecs;
+    const int start = type.indexOf(QLatin1String("codecs="));
+    if(start < 0)
+        return codecs;
+
+    const QStringList names = type.mid(start + 7).remove('"').replace('+', ' ').split(',');
+    foreach(const QString &name, names)
+    {
+        const QString trimmed = name.trimmed();
+        for(const CodecName &codec : CODEC_NAMES)
+        {
+            if(trimmed.startsWith(QLatin1String(codec.prefix)))
+            {
+                codecs |= codec.codec;
+                break;
+            }
+        }
+    }
+
+    return codecs;
 }
 
 QString YouTubeExtractor::videoId() const
@@ -145,46 +517,30 @@ QUrl YouTubeExtractor::videoUrl(YouTubeExtractor::Quality quality) const
 {
     switch(quality)
     {
-    case Small:
-        return m_videoUrls.Small;
-        break;
-    case Medium:
-        return m_videoUrls.Medium;
-        break;
     case High:
     case Default:
     case Standard:
     case Any:
-        if(!m_videoUrls.MP4_3072.isEmpty())
-            return m_videoUrls.MP4_3072;
-        if(!m_videoUrls.MP4_1080.isEmpty())
-            return m_videoUrls.MP4_1080;
-        if(!m_videoUrls.MP4_720.isEmpty())
-            return m_videoUrls.MP4_720;
-        if(!m_videoUrls.MP4_480.isEmpty())
-            return m_videoUrls.MP4_480;
-        if(!m_videoUrls.MP4_360.isEmpty())
-            return m_videoUrls.MP4_360;
-        if(!m_videoUrls.WEBM_720.isEmpty())
-            return m_videoUrls.WEBM_720;
-        if(!m_videoUrls.WEBM_360.isEmpty())
-            return m_videoUrls.WEBM_360;
-        if(!m_videoUrls.FLV_480.isEmpty())
-            return m_videoUrls.FLV_360;
-        if(!m_videoUrls._3GP_240.isEmpty())
-            return m_videoUrls._3GP_240;
-        if(!m_videoUrls._3GP_144.isEmpty())
-            return m_videoUrls._3GP_144;
-        break;
-    case FLV_360:
-        return m_videoUrls.FLV_360;
-        break;
-    case FLV_480:
-        return m_videoUrls.FLV_480;
-        break;
-    }
+    {
+        // Rank whatever was found by what the registry knows about it
+        QUrl url;
+        long long bestRank = -1;
 
-    return QUrl();
+        for(QHash<int, QUrl>::const_iterator it = m_videoUrls.constBegin(); it != m_videoUrls.constEnd(); ++it)
+        {
+            const YouTubeItag &itag = YouTubeItag::find(it.key());
+            if(itag.hasVideo() && itag.rank() > bestRank)
+            {
+                bestRank = itag.rank();
+                url = it.value();
+            }
+        }
+
+        return url;
+    }
+    default:
+        return m_videoUrls.value(quality);
+    }
 }
 
 QUrl YouTubeExtractor::thumbnailUrl(Quality quality) const
@@ -216,11 +572,94 @@ QUrl YouTubeExtractor::thumbnailUrl(Quality quality) const
         if(m_thumbnailUrls.Medium.isEmpty())
             return m_thumbnailUrls.Small;
         break;
+    default:
+        break;
     }
 
     return QUrl();
 }
 
+bool YouTubeExtractor::isLive() const
+{
+    return m_live;
+}
+
+QUrl YouTubeExtractor::hlsManifestUrl() const
+{
+    return m_hlsManifestUrl;
+}
+
+QList<YouTubeHlsVariant> YouTubeExtractor::hlsVariants() const
+{
+    return m_hlsVariants;
+}
+
+bool YouTubeExtractor::isAudioOnly() const
+{
+    return m_audioOnly;
+}
+
+void YouTubeExtractor::setAudioOnly(bool audioOnly)
+{
+    if(m_audioOnly == audioOnly)
+        return;
+
+    m_audioOnly = audioOnly;
+
+    if(audioOnly)
+    {
+        // Put back when audio-only mode is left
+        m_videoQualities = m_preferredVideoQualities;
+        m_videoMediaTypes = m_supportedMediaTypes;
+        setMediaDefaults();
+    }
+    else
+    {
+        m_preferredVideoQualities = m_videoQualities;
+        m_supportedMediaTypes = m_videoMediaTypes;
+    }
+}
+
+QList<YouTubeExtractor::Quality> YouTubeExtractor::audioQualities() const
+{
+    QList<Quality> qualities;
+    for(QHash<int, QUrl>::const_iterator it = m_videoUrls.constBegin(); it != m_videoUrls.constEnd(); ++it)
+    {
+        if(YouTubeItag::find(it.key()).kind() == YouTubeItag::AudioOnly)
+            qualities.append((Quality) it.key());
+    }
+
+    std::sort(qualities.begin(), qualities.end(), [](Quality a, Quality b) {
+        return YouTubeItag::find(a).audioRank() > YouTubeItag::find(b).audioRank();
+    });
+
+    return qualities;
+}
+
+QUrl YouTubeExtractor::audioUrl(YouTubeExtractor::Quality quality) const
+{
+    if(quality == BestAudio)
+    {
+        const QList<Quality> qualities = audioQualities();
+        return qualities.isEmpty() ? QUrl() : m_videoUrls.value(qualities.first());
+    }
+
+    if(YouTubeItag::find(quality).kind() != YouTubeItag::AudioOnly)
+        return QUrl();
+
+    return m_videoUrls.value(quality);
+}
+
+qint64 YouTubeExtractor::audioBytesReceived() const
+{
+    return m_audioBytesReceived;
+}
+
+YouTubeVideoMetadata YouTubeExtractor::metadata() const
+{
+    return m_metadata;
+}
+
 void YouTubeExtractor::setVideoId(const QString &videoId)
 {
     if(videoId.trimmed().isEmpty())
@@ -256,11 +695,84 @@ void YouTubeExtractor::setRequestUrl(const QUrl &url)
     }
 }
 
+QUrl YouTubeExtractor::videoInfoUrl() const
+{
+    return m_videoInfoUrl;
+}
+
+void YouTubeExtractor::setVideoInfoUrl(const QUrl &url)
+{
+    if(url.isValid())
+        m_videoInfoUrl = url;
+}
+
+bool YouTubeExtractor::extractFromResponse(const QString &response)
+{
+    clearResults();
+
+    try {
+        extractFromReply(response);
+        return true;
+    }
+    catch(YouTubeExtractorException &e)
+    {
+        qDebug() << "YouTubeExtractor:" << e.text();
+        setLastError(YouTubeExtractorError(e.code(), e.text()));
+    }
+
+    return false;
+}
+
 YouTubeExtractorError YouTubeExtractor::lastError() const
 {
     return m_error;
 }
 
+int YouTubeExtractor::timeout() const
+{
+    return m_timeout;
+}
+
+void YouTubeExtractor::setTimeout(int msecs)
+{
+    m_timeout = qMax(0, msecs);
+}
+
+int YouTubeExtractor::deadline() const
+{
+    return m_deadline;
+}
+
+void YouTubeExtractor::setDeadline(int msecs)
+{
+    m_deadline = qMax(0, msecs);
+}
+
+bool YouTubeExtractor::isRunning() const
+{
+    return !m_replies.isEmpty();
+}
+
+bool YouTubeExtractor::stopAtFirstMatch() const
+{
+    return m_stopAtFirstMatch;
+}
+
+void YouTubeExtractor::setStopAtFirstMatch(bool stop)
+{
+    m_stopAtFirstMatch = stop;
+}
+
+int YouTubeExtractor::timedOutCount() const
+{
+    return m_timedOutCount;
+}
+
+int YouTubeExtractor::cancelledCount() const
+{
+    return m_cancelledCount;
+}
+
 void YouTubeExtractor::start()
 {
     try {
@@ -268,19 +780,32 @@ void YouTubeExtractor::start()
             throw YouTubeExtractorException(YouTubeExtractorError::IdError, tr("No video ID provided."));
         else
         {
-            QString elField = m_elFields.at(0);
-            m_elFields.removeAll(0);
+            // A new extraction replaces the one in flight, without a signal for the old one
+            const QList<QNetworkReply *> replies = m_replies;
+            foreach(QNetworkReply *reply, replies)
+            {
+                const int attribute = reply->request().attribute(QNetworkRequest::User).toInt();
+                if(attribute == ExtractAttribute || attribute == ManifestAttribute)
+                {
+                    reply->setProperty("superseded", true);
+                    reply->abort();
+                }
+            }
+
+            clearResults();
 
-            if (elField.length() > 0)
-                elField = "&el=" + elField;
+            if(loadFromCache())
+            {
+                // Keep finished() asynchronous, as it is on a network round trip
+                QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+                return;
+            }
 
-            QString language = QLocale().languageToString(QLocale().language());
-            const QString link = FETCH_LINK.arg(m_videoId, elField, language);
+            // Retries and the manifest request share what is left of the deadline
+            m_elFieldIndex = 0;
+            m_extractionTimer.start();
 
-            QNetworkRequest request;
-            request.setUrl(QUrl(link));
-            request.setAttribute(QNetworkRequest::User, ExtractAttribute);
-            m_manager->get(request);
+            requestVideoInfo();
         }
     }
     catch(YouTubeExtractorException &e)
@@ -300,34 +825,195 @@ void YouTubeExtractor::downloadThumbnail(const QString &filePath, YouTubeExtract
             throw YouTubeExtractorException(YouTubeExtractorError::FileError, tr("The file path provided is empty."));
         else
         {
-            m_thumbnailFilePath = filePath;
+            // Kept with the request, as several downloads may overlap
             QNetworkRequest request;
             request.setAttribute(QNetworkRequest::User, DownloadAttribute);
+            request.setAttribute(FILE_PATH_ATTRIBUTE, filePath);
             request.setUrl(thumbnailUrl(quality));
-            m_manager->get(request);
+            sendRequest(request, m_deadline);
         }
     }
     catch(YouTubeExtractorException &e)
     {
         qDebug() << "YouTubeExtractor: " << e.what();
-        setLastError(YouTubeExtractorError(e.code(), e.text()));
-        emit thumbnailReady();
+        emit thumbnailReady(filePath, YouTubeExtractorError(e.code(), e.text()));
     }
 }
 
-bool YouTubeExtractor::isSupportedMedia(const QString &mime)
+void YouTubeExtractor::streamAudio(QIODevice *device, YouTubeExtractor::Quality quality)
 {
-    /*QMimeDatabase().allMimeTypes()*/
-    foreach(const QMimeType &t, m_supportedMedia)
+    requestAudio(device, quality);
+}
+
+void YouTubeExtractor::downloadAudio(const QString &filePath, YouTubeExtractor::Quality quality)
+{
+    if(filePath.trimmed().isEmpty())
     {
-        if(t.name() == mime)
-            return true;
+        emit audioReady(YouTubeExtractorError(YouTubeExtractorError::FileError, tr("The file path provided is empty.")));
+        return;
     }
 
-    return false;
+    QFile *file = new QFile(filePath, this);
+    if(!file->open(QIODevice::WriteOnly))
+    {
+        const YouTubeExtractorError error(YouTubeExtractorError::FileError, file->errorString());
+        delete file;
+        emit audioReady(error);
+        return;
+    }
+
+    // The file goes away with the reply
+    QNetworkReply *reply = requestAudio(file, quality);
+    if(reply)
+        file->setParent(reply);
+    else
+        delete file;
+}
+
+void YouTubeExtractor::abort()
+{
+    // Skip the remaining "el" fields so that no retry is issued
+    m_elFieldIndex = m_elFields.count();
+
+    // Aborting a reply finishes it synchronously, so work on a copy
+    const QList<QNetworkReply *> replies = m_replies;
+    foreach(QNetworkReply *reply, replies)
+        reply->abort();
+}
+
+bool YouTubeExtractor::isSupportedMedia(const QString &mime)
+{
+    // The MIME data comes before the ";" and the CODEC data after it
+    const int separator = mime.indexOf(';');
+
+    if(!(m_supportedMediaTypes & mediaTypeFromName(mime.left(separator).trimmed())))
+        return false;
+
+    if(separator < 0 || m_supportedCodecs == Codecs(YouTubeItag::AllCodecs))
+        return true;
+
+    // Codecs that are not recognised are let through
+    return !(codecsFromType(mime.mid(separator + 1)) & ~m_supportedCodecs);
 }
 
 //region Private
+void YouTubeExtractor::requestVideoInfo()
+{
+    const QString elField = m_elFields.value(m_elFieldIndex);
+    const QString language = QLocale().languageToString(QLocale().language());
+
+    QUrlQuery query;
+    query.addQueryItem("video_id", m_videoId);
+    if (elField.length() > 0)
+        query.addQueryItem("el", elField);
+    query.addQueryItem("ps", "default");
+    query.addQueryItem("eurl", "");
+    query.addQueryItem("gl", "US");
+    query.addQueryItem("hl", language);
+
+    QUrl url(m_videoInfoUrl);
+    url.setQuery(query);
+
+    QNetworkRequest request;
+    request.setUrl(url);
+    request.setAttribute(QNetworkRequest::User, ExtractAttribute);
+
+    QNetworkReply *reply = sendRequest(request, remainingDeadline());
+    m_parsers.insert(reply, QSharedPointer<YouTubeStreamParser>(new YouTubeStreamParser));
+    connect(reply, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+}
+
+QNetworkReply *YouTubeExtractor::requestAudio(QIODevice *device, YouTubeExtractor::Quality quality)
+{
+    try {
+        const QUrl url = audioUrl(quality);
+
+        if(url.isEmpty())
+            throw YouTubeExtractorException(YouTubeExtractorError::UrlError, tr("No audio URL available."));
+        else if(!device || !device->isWritable())
+            throw YouTubeExtractorException(YouTubeExtractorError::FileError, tr("The device is not open for writing."));
+        else
+        {
+            QNetworkRequest request;
+            request.setUrl(url);
+            request.setAttribute(QNetworkRequest::User, AudioAttribute);
+
+            QNetworkReply *reply = sendRequest(request);
+            m_audioSinks.insert(reply, device);
+            connect(reply, SIGNAL(readyRead()), this, SLOT(onAudioReadyRead()));
+            connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SIGNAL(audioProgress(qint64,qint64)));
+
+            return reply;
+        }
+    }
+    catch(YouTubeExtractorException &e)
+    {
+        qDebug() << "YouTubeExtractor: " << e.text();
+        emit audioReady(YouTubeExtractorError(e.code(), e.text()));
+    }
+
+    return 0;
+}
+
+void YouTubeExtractor::requestManifest()
+{
+    QNetworkRequest request;
+    request.setUrl(m_hlsManifestUrl);
+    request.setAttribute(QNetworkRequest::User, ManifestAttribute);
+    sendRequest(request, remainingDeadline());
+}
+
+QNetworkReply *YouTubeExtractor::sendRequest(const QNetworkRequest &request, int deadline)
+{
+    QNetworkReply *reply = m_manager->get(request);
+    m_replies.append(reply);
+
+    // Whichever of the timeout and the deadline comes first. Audio streams last as
+    // long as the track does, so only a stall counts against them; onAudioReadyRead()
+    // restarts their timer.
+    const Attribute attribute = (Attribute) request.attribute(QNetworkRequest::User).toInt();
+    int interval = m_timeout;
+    if(attribute == AudioAttribute)
+        interval = m_timeout > 0 ? m_timeout : AUDIO_INACTIVITY_TIMEOUT;
+    else if(deadline > 0 && (interval == 0 || deadline < interval))
+        interval = deadline;
+
+    if(interval > 0)
+    {
+        // Parented to the reply so that it goes away with it
+        QTimer *timer = new QTimer(reply);
+        timer->setObjectName(REQUEST_TIMER_NAME);
+        timer->setSingleShot(true);
+        connect(timer, SIGNAL(timeout()), this, SLOT(onRequestTimeout()));
+        timer->start(interval);
+    }
+
+    return reply;
+}
+
+void YouTubeExtractor::clearResults()
+{
+    // Results and errors of a previous run must not leak into this one
+    setLastError(YouTubeExtractorError());
+
+    ThumbnailUrls noThumbnailUrls;
+    m_videoUrls.clear();
+    m_thumbnailUrls = noThumbnailUrls;
+    m_hlsManifestUrl.clear();
+    m_hlsVariants.clear();
+    m_metadata = YouTubeVideoMetadata();
+    m_live = false;
+}
+
+int YouTubeExtractor::remainingDeadline() const
+{
+    if(m_deadline <= 0 || !m_extractionTimer.isValid())
+        return 0;
+
+    // A request sent past the deadline still gets a timer, which fires right away
+    return qMax<qint64>(1, m_deadline - m_extractionTimer.elapsed());
+}
+
 QMap<QString, QString> YouTubeExtractor::getMapFromQuery(const QString &query)
 {
     QMap<QString, QString> map;
@@ -336,14 +1022,15 @@ QMap<QString, QString> YouTubeExtractor::getMapFromQuery(const QString &query)
 
     foreach(const QByteArray &field, fields)
     {
-        QList<QByteArray> pair = field.split('=');
+        // Values may hold '=' themselves, so only split at the first one
+        const int separator = field.indexOf('=');
 
-        if (pair.length() == 2)
+        if (separator > 0)
         {
-            QString key = pair[0];
+            QString key = field.left(separator);
             // This string will still have percent signs in it, so you have to convert them to actual characters
             // with QByteArray::fromPercentEncoding().
-            QString value = QByteArray::fromPercentEncoding(pair[1]);
+            QString value = QByteArray::fromPercentEncoding(field.mid(separator + 1));
 
             map.insert(key, value);
         }
@@ -354,59 +1041,74 @@ QMap<QString, QString> YouTubeExtractor::getMapFromQuery(const QString &query)
 
 void YouTubeExtractor::extractFromReply(const QString &html)
 {
-    QMap<QString, QString> video = getMapFromQuery(html.toUtf8());
+    YouTubeStreamParser parser;
+    parser.feed(html.toUtf8());
+    parser.finish();
 
-    // Get the url encoded format stream map first
-    if(video.contains("url_encoded_fmt_stream_map"))
-    {
-        QStringList streamQueries = video.value("url_encoded_fmt_stream_map").split(",");
+    completeExtraction(&parser);
+}
 
-        // Get adaptive format list (for some reason I am unaware of)
-        QStringList adaptiveFormats = video.value("adaptive_fmts").split(",");
-        // Append the two lists
-        streamQueries.append(adaptiveFormats);
+bool YouTubeExtractor::extractStreams(YouTubeStreamParser *parser)
+{
+    bool matched = false;
+
+    foreach(const QByteArray &streamQuery, parser->takeStreamQueries())
+    {
+        QMap<QString, QString> streamMap = getMapFromQuery(streamQuery);
 
+        // The value for the "type" key contains both the MIME data and the CODEC data.
+        const QString type = streamMap.value("type");
+        QString url = streamMap.value("url");
 
-        QMap<int, QString> streamLinks;
-        foreach(const QString &streamQuery, streamQueries)
+        if (!url.trimmed().isEmpty() && isSupportedMedia(type))
         {
-            QMap<QString, QString> streamMap = getMapFromQuery(streamQuery);
+            const QString signature = streamMap.value("sig").toUtf8();
 
-            // The value for the "type" key contains both the MIME data and the CODEC data.
-            // To get the MIME data, split the value at the ";" and return the first value of the string list.
-            QString type = streamMap.value("type").split(";").first();
-            QString url = streamMap.value("url");
+            if (!signature.trimmed().isEmpty())
+            {
+                url = url + "&signature=" + signature;
+            }
 
-            if (!url.trimmed().isEmpty() && isSupportedMedia(type))
+            // Confused about this place
+            QMap<QString, QString> urlMap = getMapFromQuery(url);
+            if (urlMap.contains("signature"))
             {
-                const QString signature = streamMap.value("sig").toUtf8();
+                const int itag = streamMap.value("itag").toInt();
+                const QUrl streamUrl(url.toUtf8());
 
-                if (!signature.trimmed().isEmpty())
-                {
-                    url = url + "&signature=" + signature;
-                }
+                emit streamFound(itag, streamUrl);
 
-                // Confused about this place
-                QMap<QString, QString> urlMap = getMapFromQuery(url);
-                if (urlMap.contains("signature"))
+                if(m_preferredVideoQualities.contains((Quality) itag))
                 {
-                    streamLinks.insert(streamMap.value("itag").toInt(), url);
+                    setVideoUrl(streamUrl, (Quality) itag);
+                    matched = true;
                 }
             }
         }
+    }
 
-        foreach(Quality quality, m_preferredVideoQualities)
-        {
-            if(streamLinks.value(quality) != 0)
-            {
-                const QString streamLink = streamLinks.value(quality);
-                setVideoUrl(QUrl(streamLink.toUtf8()), quality);
-            }
-        }
+    return matched;
+}
+
+void YouTubeExtractor::completeExtraction(YouTubeStreamParser *parser)
+{
+    if(parser->hasError())
+        throw YouTubeExtractorException(YouTubeExtractorError::ParseError, parser->errorString());
+
+    extractStreams(parser);
+
+    const YouTubeVideoMetadata video(m_videoId, parser->rawFields());
+
+    // Get the url encoded format stream map first; live broadcasts only have an HLS manifest
+    if(parser->hasStreamMap() || video.contains("hlsvp"))
+    {
+        m_metadata = video;
+        m_hlsManifestUrl = QUrl(video.value("hlsvp"));
+        m_live = video.value("live_playback") == "1";
 
         if(video.contains("iurlmq"))
             setThumbnailUrl(QUrl(video.value("iurlmq")), Medium);
-        if(video.contains("iurlmq"))
+        if(video.contains("iurlhq"))
             setThumbnailUrl(QUrl(video.value("iurlhq")), High);
         if(video.contains("iurl"))
             setThumbnailUrl(QUrl(video.value("iurl")), Default);
@@ -415,58 +1117,37 @@ void YouTubeExtractor::extractFromReply(const QString &html)
     }
 
     else
-        throw YouTubeExtractorException(YouTubeExtractorError::ParseError, QString(video.value("reason")).replace("+", " "));
+        throw YouTubeExtractorException(YouTubeExtractorError::ParseError, video.value("reason"));
 }
 
-void YouTubeExtractor::setVideoUrl(const QUrl &url, YouTubeExtractor::Quality quality)
+void YouTubeExtractor::extractFromManifest(const QByteArray &manifest, const QUrl &baseUrl)
 {
-    if(url.isEmpty())
-        return;
+    m_hlsVariants = YouTubeHlsPlaylist::parseMasterPlaylist(manifest, baseUrl);
+    if(m_hlsVariants.isEmpty())
+        throw YouTubeExtractorException(YouTubeExtractorError::ParseError, tr("The HLS manifest has no variants."));
 
-    switch(quality)
+    // Variants go through the same selection as the stream map entries
+    foreach(const YouTubeHlsVariant &variant, m_hlsVariants)
     {
-    case Small:
-        m_videoUrls.Small = url;
-        break;
-    case Medium:
-        m_videoUrls.Medium = url;
-        break;
-    case FLV_360:
-        m_videoUrls.FLV_360 = url;
-        break;
-    case FLV_480:
-        m_videoUrls.FLV_480 = url;
-        break;
-    case _3GP_144:
-        m_videoUrls._3GP_144 = url;
-        break;
-    case _3GP_240:
-        m_videoUrls._3GP_240 = url;
-        break;
-    case MP4_720:
-        m_videoUrls.MP4_720 = url;
-        break;
-    case MP4_360:
-        m_videoUrls.MP4_360 = url;
-        break;
-    case MP4_480:
-        m_videoUrls.MP4_480 = url;
-        break;
-    case MP4_1080:
-        m_videoUrls.MP4_1080 = url;
-        break;
-    case MP4_3072:
-        m_videoUrls.MP4_3072 = url;
-        break;
-    case WEBM_360:
-        m_videoUrls.WEBM_360 = url;
-        break;
-    case WEBM_720:
-        m_videoUrls.WEBM_720 = url;
-        break;
+        const Codecs codecs = codecsFromType("codecs=" + variant.codecs);
+        if(!(m_supportedMediaTypes & VideoMp2t) || (codecs & ~m_supportedCodecs))
+            continue;
+
+        emit streamFound(variant.itag, variant.url);
+
+        if(m_preferredVideoQualities.contains((Quality) variant.itag))
+            setVideoUrl(variant.url, (Quality) variant.itag);
     }
 }
 
+void YouTubeExtractor::setVideoUrl(const QUrl &url, YouTubeExtractor::Quality quality)
+{
+    if(url.isEmpty() || !YouTubeItag::find(quality).isValid())
+        return;
+
+    m_videoUrls.insert(quality, url);
+}
+
 void YouTubeExtractor::setThumbnailUrl(const QUrl &url, YouTubeExtractor::Quality quality)
 {
     if(url.isEmpty())
@@ -489,6 +1170,8 @@ void YouTubeExtractor::setThumbnailUrl(const QUrl &url, YouTubeExtractor::Qualit
     case Standard:
         m_thumbnailUrls.Standard = url;
         break;
+    default:
+        break;
     }
 }
 
@@ -496,3 +1179,77 @@ void YouTubeExtractor::setLastError(YouTubeExtractorError e)
 {
     m_error = e;
 }
+
+QString YouTubeExtractor::cacheKey() const
+{
+    // Entries hold filtered results, so extractors that filter differently
+    // must not see each other's
+    QList<int> qualities;
+    foreach(Quality quality, m_preferredVideoQualities)
+        qualities.append(quality);
+    std::sort(qualities.begin(), qualities.end());
+
+    QByteArray filters;
+    QDataStream stream(&filters, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << qualities << quint32(m_supportedMediaTypes) << quint32(m_supportedCodecs) << m_audioOnly;
+
+    const QByteArray hash = QCryptographicHash::hash(filters, QCryptographicHash::Sha1).toHex().left(8);
+    return m_videoId + ':' + QString::fromLatin1(hash);
+}
+
+bool YouTubeExtractor::loadFromCache()
+{
+    QByteArray payload;
+    if(!m_sharedCache || !m_sharedCache->find(cacheKey(), &payload))
+        return false;
+
+    QDataStream stream(qUncompress(payload));
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    QHash<int, QUrl> videoUrls;
+    ThumbnailUrls thumbnailUrls;
+    QUrl hlsManifestUrl;
+    bool live = false;
+    QList<YouTubeHlsVariant> hlsVariants;
+    stream >> videoUrls
+           >> thumbnailUrls.Small >> thumbnailUrls.Medium >> thumbnailUrls.High
+           >> thumbnailUrls.Default >> thumbnailUrls.Standard
+           >> hlsManifestUrl >> live >> hlsVariants;
+
+    if(stream.status() != QDataStream::Ok || videoUrls.isEmpty())
+        return false;
+
+    m_videoUrls = videoUrls;
+    m_thumbnailUrls = thumbnailUrls;
+    m_hlsManifestUrl = hlsManifestUrl;
+    m_live = live;
+    m_hlsVariants = hlsVariants;
+
+    return true;
+}
+
+void YouTubeExtractor::storeInCache()
+{
+    if(!m_sharedCache || m_videoUrls.isEmpty())
+        return;
+
+    // The entry is only as good as the first stream URL to expire
+    qint64 expiresAt = QDateTime::currentMSecsSinceEpoch() / 1000 + CACHE_TTL;
+    foreach(const QUrl &url, m_videoUrls)
+    {
+        const qint64 expire = QUrlQuery(url).queryItemValue("expire").toLongLong();
+        if(expire > 0)
+            expiresAt = qMin(expiresAt, expire);
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << m_videoUrls
+           << m_thumbnailUrls.Small << m_thumbnailUrls.Medium << m_thumbnailUrls.High
+           << m_thumbnailUrls.Default << m_thumbnailUrls.Standard
+           << m_hlsManifestUrl << m_live << m_hlsVariants;
+
+    m_sharedCache->insert(cacheKey(), qCompress(payload), expiresAt - CACHE_EXPIRY_MARGIN);
+}
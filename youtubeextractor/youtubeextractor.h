@@ -4,45 +4,24 @@
 #include <QObject>
 #include <QUrl>
 #include <QMimeType>
+#include <QHash>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QIODevice>
+#include <QElapsedTimer>
+#include "youtubeitag.h"
+#include "youtubevideometadata.h"
+
+// Older Qt versions cannot deprecate single enumerators
+#ifndef Q_DECL_ENUMERATOR_DEPRECATED
+#define Q_DECL_ENUMERATOR_DEPRECATED
+#endif
 
 class QNetworkAccessManager;
 class QNetworkReply;
-
-struct VideoUrls {
-    VideoUrls() {}
-    VideoUrls(const QUrl &Small, const QUrl &Medium, const QUrl &FLV_360,
-              const QUrl &FLV_480, const QUrl &_3GP_240, const QUrl &_3GP_144,
-              const QUrl &MP4_720, const QUrl &MP4_360, const QUrl &MP4_480,
-              const QUrl &MP4_1080, const QUrl &MP4_3072, const QUrl &WEBM_360,
-              const QUrl &WEBM_720) :
-        Small(Small), Medium(Medium),
-        FLV_360(FLV_360), FLV_480(FLV_480), _3GP_240(_3GP_240),
-        _3GP_144(_3GP_144), MP4_720(MP4_720),
-        MP4_360(MP4_360), MP4_480(MP4_480), MP4_1080(MP4_1080),
-        MP4_3072(MP4_3072), WEBM_360(WEBM_360), WEBM_720(WEBM_720) {}
-
-    VideoUrls operator =(VideoUrls &other)
-    {
-        Small= other.Small;
-        Medium = other.Medium;
-        FLV_360 = other.FLV_360;
-        FLV_480 = other.FLV_480;
-        _3GP_240 = other._3GP_240;
-        _3GP_144 = other._3GP_144;
-        MP4_720 = other.MP4_720;
-        MP4_360 = other.MP4_360;
-        MP4_480 = other.MP4_480;
-        MP4_1080 = other.MP4_1080;
-        MP4_3072 = other.MP4_3072;
-        WEBM_360 = other.WEBM_360;
-        WEBM_720 = other.WEBM_720;
-
-        return *this;
-    }
-
-    QUrl Small, Medium,
-    FLV_360, FLV_480, _3GP_240, _3GP_144, MP4_720, MP4_360, MP4_480, MP4_1080, MP4_3072, WEBM_360, WEBM_720;
-};
+class QNetworkRequest;
+class YouTubeStreamParser;
+class YouTubeSharedCache;
 
 struct ThumbnailUrls {
     ThumbnailUrls() {}
@@ -51,60 +30,58 @@ struct ThumbnailUrls {
         Small(Small), Medium(Medium), High(High),
         Default(Default), Standard(Standard) {}
 
-    ThumbnailUrls operator =(ThumbnailUrls &other)
-    {
-        Small = other.Small;
-        Medium = other.Medium;
-        High = other.High;
-        Default = other.Default;
-        Standard = other.Standard;
+    QUrl Small, Medium, High, Default, Standard;
+};
 
-        return *this;
-    }
+struct YouTubeHlsVariant {
+    YouTubeHlsVariant() :
+        itag(0), bandwidth(0), width(0), height(0) {}
 
-    QUrl Small, Medium, High, Default, Standard;
+    QUrl url;
+    int itag;
+    int bandwidth;
+    int width;
+    int height;
+    QString codecs;
 };
 
 class YouTubeExtractorError {
 public:
-    enum Code {Unknown = -1, NetworkError, FileError, UrlError, IdError, RegexError, ParseError};
+    enum Code {Unknown = -1, NetworkError, FileError, UrlError, IdError, RegexError, ParseError,
+               TimeoutError, CancelledError};
     YouTubeExtractorError() :
         m_code(Unknown) {}
     YouTubeExtractorError(Code code, const QString &text) :
         m_code(code), m_text(text) {}
 
-    YouTubeExtractorError operator =(YouTubeExtractorError &other)
-    {
-        m_code = other.code();
-        m_text = other.text();
-
-        return *this;
-    }
-
     Code code() const { return m_code; }
     QString text() const { return m_text; }
-    bool isValid() { return !m_text.trimmed().isEmpty(); }
+    bool isValid() const { return !m_text.trimmed().isEmpty(); }
 private:
     Code m_code;
     QString m_text;
 };
 
+Q_DECLARE_METATYPE(YouTubeExtractorError)
+
 class YouTubeExtractorException : std::exception {
 public:
     YouTubeExtractorException() :
         m_code(YouTubeExtractorError::Unknown) {}
     YouTubeExtractorException(YouTubeExtractorError::Code code, const QString &text) :
-        m_code(code), m_text(text) {}
+        m_code(code), m_text(text), m_what(text.toUtf8()) {}
 
     virtual ~YouTubeExtractorException() {}
 
     YouTubeExtractorError::Code code() const { return m_code; }
     QString text() const { return m_text; }
 
-    virtual const char *what() const { return m_text.toStdString().c_str(); }
+    // Kept alongside the text so that the pointer stays valid
+    virtual const char *what() const Q_DECL_NOTHROW { return m_what.constData(); }
 private:
     YouTubeExtractorError::Code m_code;
     QString m_text;
+    QByteArray m_what;
 };
 
 class YouTubeExtractor : public QObject
@@ -113,30 +90,71 @@ class YouTubeExtractor : public QObject
 public:
     enum Quality {
         Small = 36,
-        Medium = 0, // 18
+        Medium = 18,
         High = -1,
         Default = -2,
         Standard = -3,
         Any = -4,
+        BestAudio = -5,
 
-        FLV_360 = 5,
-        FLV_480 = 6,    // unsure
-        _3GP_240 = 13,  // unsure
-        _3GP_144 = 17,
+        // The values are itags; see youtubeitag.h for what each one holds
+        FLV_240 = 5,
+        FLV_270 = 6,
+        _3GP_144_30FPS = 13,
+        _3GP_144 = 17,          // 12 fps
         MP4_720 = 22,
-        MP4_360 = 34,
-        MP4_480 = 35,
+        FLV_H264_360 = 34,
+        FLV_H264_480 = 35,
         MP4_1080 = 37,
         MP4_3072 = 38,
         WEBM_360 = 43,
-        WEBM_720 = 45
+        WEBM_720 = 45,
+        HLS_144 = 91,
+        HLS_240 = 92,
+        HLS_360 = 93,
+        HLS_480 = 94,
+        HLS_720 = 95,
+        HLS_1080 = 96,
+
+        // Audio only
+        M4A_48 = 139,
+        M4A_128 = 140,
+        M4A_256 = 141,
+        VORBIS_128 = 171,
+        VORBIS_256 = 172,
+        OPUS_50 = 249,
+        OPUS_70 = 250,
+        OPUS_160 = 251,
+
+        // Deprecated: these names do not match what the itags hold. The MP4
+        // stream at 360p is Medium and the 3GP one at 240p is Small.
+        FLV_360 Q_DECL_ENUMERATOR_DEPRECATED = FLV_240,
+        FLV_480 Q_DECL_ENUMERATOR_DEPRECATED = FLV_270,
+        _3GP_240 Q_DECL_ENUMERATOR_DEPRECATED = _3GP_144_30FPS,
+        MP4_360 Q_DECL_ENUMERATOR_DEPRECATED = FLV_H264_360,
+        MP4_480 Q_DECL_ENUMERATOR_DEPRECATED = FLV_H264_480
     };
 
     enum Attribute {
         ExtractAttribute,
-        DownloadAttribute
+        DownloadAttribute,
+        ManifestAttribute,
+        AudioAttribute
     };
 
+    enum MediaType {
+        NoMedia = 0x0,
+        VideoMp4 = 0x1,
+        VideoWebm = 0x2,
+        Video3gpp = 0x4,
+        VideoFlv = 0x8,
+        AudioMp4 = 0x10,
+        AudioWebm = 0x20,
+        VideoMp2t = 0x40    // HLS variants of live broadcasts
+    };
+    Q_DECLARE_FLAGS(MediaTypes, MediaType)
+    Q_DECLARE_FLAGS(Codecs, YouTubeItag::Codec)
+
     explicit YouTubeExtractor(QObject *parent = 0);
     explicit YouTubeExtractor(const QString &videoId, QObject *parent = 0);
     explicit YouTubeExtractor(const QUrl &requestUrl, QObject *parent = 0);
@@ -144,66 +162,188 @@ public:
     QList<Quality> preferredVideoQualities();
     void setPreferredVideoQualities(const QList<Quality> &preferredVideoQualities);
 
+    // Accepts a bare MIME type or a full "type" field with a codecs parameter
     bool isSupportedMedia(const QString &mime);
     void setSupportedMedia(const QList<QMimeType> &);
     QList<QMimeType> supportedMedia() const;
 
+    MediaTypes supportedMediaTypes() const;
+    void setSupportedMediaTypes(MediaTypes types);
+
+    Codecs supportedCodecs() const;
+    void setSupportedCodecs(Codecs codecs);
+
+    // Results are looked up in and published to the cache, which is not owned
+    YouTubeSharedCache *sharedCache() const;
+    void setSharedCache(YouTubeSharedCache *cache);
+
+    static MediaType mediaTypeFromName(const QString &name);
+    static Codecs codecsFromType(const QString &type);
+
     QString videoId() const;
 
+    // High, Default, Standard and Any pick the best stream found
     QUrl videoUrl(Quality) const;
     QUrl thumbnailUrl(Quality) const;
 
+    // In audio-only mode only the audio adaptive streams are extracted. Turning it
+    // on replaces the preferred qualities and supported media types with audio
+    // defaults; turning it off puts back the ones set before, so changes made in
+    // between are discarded. The codec filter is left as it is.
+    bool isAudioOnly() const;
+    void setAudioOnly(bool audioOnly);
+
+    // Audio streams found, best first
+    QList<Quality> audioQualities() const;
+    QUrl audioUrl(Quality = BestAudio) const;
+
+    // Bytes of audio streamed so far, to compare against downloading whole videos
+    qint64 audioBytesReceived() const;
+
+    // Live broadcasts come with an HLS master playlist instead of stream maps.
+    // Its variants are also available through videoUrl(); pass one to
+    // YouTubeHlsPlaylist to follow its segments.
+    bool isLive() const;
+    QUrl hlsManifestUrl() const;
+    QList<YouTubeHlsVariant> hlsVariants() const;
+
+    // Title, author, keywords and the like; fields are only decoded when read.
+    // Empty when the result came from the shared cache.
+    YouTubeVideoMetadata metadata() const;
+
     void setVideoId(const QString &videoId);
     void setRequestUrl(const QUrl &url);
 
+    // Where get_video_info is requested from; mirrors and tests may point it elsewhere
+    QUrl videoInfoUrl() const;
+    void setVideoInfoUrl(const QUrl &url);
+
+    // Extracts from a get_video_info response obtained some other way, such as
+    // a saved one, as start() would from the network; no signal is emitted
+    bool extractFromResponse(const QString &response);
+
+    // Splits a query string into its fields, with the values percent-decoded
+    static QMap<QString, QString> getMapFromQuery(const QString &query);
+
+    // Error of the last extraction. Thumbnail and audio downloads report theirs
+    // through thumbnailReady() and audioReady() instead.
     YouTubeExtractorError lastError() const;
+
+    // Per-request timeout in milliseconds; 0 disables it. For audio streams it
+    // limits the wait between two chunks instead.
+    int timeout() const;
+    void setTimeout(int msecs);
+
+    // Deadline in milliseconds for an extraction started by start(), retries and
+    // the HLS manifest included, and for each downloadThumbnail() on its own;
+    // 0 disables it
+    int deadline() const;
+    void setDeadline(int msecs);
+
+    bool isRunning() const;
+
+    // Finish as soon as a stream of a preferred quality has been found,
+    // without waiting for the rest of the response. Fields that come after
+    // the stream maps are never read, so thumbnails, the HLS manifest and
+    // metadata are usually missing, and the result is not cached.
+    bool stopAtFirstMatch() const;
+    void setStopAtFirstMatch(bool stop);
+
+    int timedOutCount() const;
+    int cancelledCount() const;
 public slots:
+    // Starting again while an extraction is in flight replaces it; only the
+    // latest one emits finished()
     void start();
 
     // Download thumbnail
     void downloadThumbnail(const QString &filePath, Quality = Default);
+
+    // Stream the audio track into a device opened for writing as it arrives.
+    // Audio streams are exempt from the deadline. They end with a TimeoutError
+    // once no data has arrived for timeout(), or for 30 seconds when it is 0.
+    void streamAudio(QIODevice *device, Quality = BestAudio);
+    void downloadAudio(const QString &filePath, Quality = BestAudio);
+
+    // Abort every request in flight and drop pending retries
+    void abort();
 private slots:
     void onFinished(QNetworkReply *reply);
+    void onReadyRead();
+    void onAudioReadyRead();
+    void onRequestTimeout();
 signals:
     void finished();
-    void thumbnailReady();
+
+    // Streams reported before a retry with the next "el" field are dropped
+    // from the results; the retry reports its own
+    void streamFound(int itag, const QUrl &url);
+
+    // The error is not valid when the download succeeded
+    void thumbnailReady(const QString &filePath, const YouTubeExtractorError &error);
+    void audioProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void audioReady(const YouTubeExtractorError &error);
 private:
     QString m_videoId;
     QList<QString> m_elFields;
     QNetworkAccessManager *m_manager;
     QList<Quality> m_preferredVideoQualities;
-    VideoUrls m_videoUrls;
+    QHash<int, QUrl> m_videoUrls;
     ThumbnailUrls m_thumbnailUrls;
-    QList<QMimeType> m_supportedMedia;
-    QString m_thumbnailFilePath;
+    QUrl m_hlsManifestUrl;
+    QList<YouTubeHlsVariant> m_hlsVariants;
+    YouTubeVideoMetadata m_metadata;
+    bool m_live;
+    MediaTypes m_supportedMediaTypes;
+    QList<Quality> m_videoQualities;
+    MediaTypes m_videoMediaTypes;
+    Codecs m_supportedCodecs;
     QUrl m_requestUrl;
+    QUrl m_videoInfoUrl;
     YouTubeExtractorError m_error;
+    QList<QNetworkReply *> m_replies;
+    QHash<QNetworkReply *, QSharedPointer<YouTubeStreamParser> > m_parsers;
+    bool m_stopAtFirstMatch;
+    bool m_audioOnly;
+    QHash<QNetworkReply *, QPointer<QIODevice> > m_audioSinks;
+    qint64 m_audioBytesReceived;
+    YouTubeSharedCache *m_sharedCache;
+    QElapsedTimer m_extractionTimer;
+    int m_elFieldIndex;
+    int m_timeout;
+    int m_deadline;
+    int m_timedOutCount;
+    int m_cancelledCount;
 
     void setDefaults();
-    QMap<QString, QString> getMapFromQuery(const QString &query);
-
-    void extractFromReply(const QString &html) throw (YouTubeExtractorException);
+    void setMediaDefaults();
+    QNetworkReply *requestAudio(QIODevice *device, Quality quality);
+    void requestVideoInfo();
+    void requestManifest();
+    QNetworkReply *sendRequest(const QNetworkRequest &request, int deadline = 0);
+    int remainingDeadline() const;
+    void clearResults();
+
+    void extractFromReply(const QString &html);
+    bool extractStreams(YouTubeStreamParser *parser);
+    void completeExtraction(YouTubeStreamParser *parser);
+    void extractFromManifest(const QByteArray &manifest, const QUrl &baseUrl);
 
     void setVideoUrl(const QUrl &url, Quality);
     void setThumbnailUrl(const QUrl &url, Quality);
     void setLastError(YouTubeExtractorError e);
+
+    QString cacheKey() const;
+    bool loadFromCache();
+    void storeInCache();
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(YouTubeExtractor::MediaTypes)
+Q_DECLARE_OPERATORS_FOR_FLAGS(YouTubeExtractor::Codecs)
+
 #endif // YOUTUBEEXTRACTOR_H
 
-//Video formats     Resolution      Itag
-//FLV               360p            5
-//FLV               480p?           6
-//3GP               240?            13
-//3GP               144p            17
-//MP4               480p            18
-//MP4               720p            22
-//MP4               360p            34
-//MP4               480p            35
-//MP4               1080p           37
-//MP4               3072p           38
-//WEBM              360p            43
-//WEBM              720p            45
+//Video formats     See youtubeitag.h
 
 //Key               Value
 //url               stream/download URL
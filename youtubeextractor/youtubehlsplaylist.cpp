@@ -0,0 +1,344 @@
+#include "youtubehlsplaylist.h"
+#include "youtubeitag.h"
+#include <QtNetwork>
+
+// Used until the playlist tells otherwise, in seconds
+const int DEFAULT_TARGET_DURATION = 5;
+
+// Failed reloads in a row that are retried before the session ends
+const int MAX_RETRIES = 5;
+
+// Delay before the first retry in milliseconds, doubled for each one after it
+const int RETRY_DELAY = 500;
+
+// Splits an attribute list such as BANDWIDTH=1280000,CODECS="avc1.4d401f,mp4a.40.2"
+static QMap<QByteArray, QByteArray> parseAttributes(const QByteArray &list)
+{
+    QMap<QByteArray, QByteArray> attributes;
+    int pos = 0;
+
+    while(pos < list.size())
+    {
+        const int equals = list.indexOf('=', pos);
+        if(equals < 0)
+            break;
+
+        const QByteArray name = list.mid(pos, equals - pos).trimmed();
+        const int valueStart = equals + 1;
+        int end;
+        QByteArray value;
+
+        if(valueStart < list.size() && list.at(valueStart) == '"')
+        {
+            // Quoted values may contain commas
+            end = list.indexOf('"', valueStart + 1);
+            if(end < 0)
+                end = list.size();
+            value = list.mid(valueStart + 1, end - valueStart - 1);
+        }
+        else
+        {
+            end = list.indexOf(',', valueStart);
+            if(end < 0)
+                end = list.size();
+            value = list.mid(valueStart, end - valueStart).trimmed();
+        }
+
+        attributes.insert(name, value);
+
+        const int comma = list.indexOf(',', end);
+        pos = comma < 0 ? list.size() : comma + 1;
+    }
+
+    return attributes;
+}
+
+YouTubeHlsPlaylist::YouTubeHlsPlaylist(const QUrl &url, QObject *parent) :
+    QObject(parent),
+    m_url(url),
+    m_reply(0),
+    m_lastSequence(-1),
+    m_mediaSequence(-1),
+    m_discontinuitySequence(-1),
+    m_targetDuration(DEFAULT_TARGET_DURATION),
+    m_timeout(0),
+    m_failures(0),
+    m_ended(false)
+{
+    m_manager = new QNetworkAccessManager(this);
+    connect(m_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(onFinished(QNetworkReply*)));
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setSingleShot(true);
+    connect(m_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+QUrl YouTubeHlsPlaylist::url() const
+{
+    return m_url;
+}
+
+bool YouTubeHlsPlaylist::isEnded() const
+{
+    return m_ended;
+}
+
+int YouTubeHlsPlaylist::targetDuration() const
+{
+    return m_targetDuration;
+}
+
+qint64 YouTubeHlsPlaylist::lastSequence() const
+{
+    return m_lastSequence;
+}
+
+int YouTubeHlsPlaylist::timeout() const
+{
+    return m_timeout;
+}
+
+void YouTubeHlsPlaylist::setTimeout(int msecs)
+{
+    m_timeout = qMax(0, msecs);
+}
+
+YouTubeExtractorError YouTubeHlsPlaylist::lastError() const
+{
+    return m_error;
+}
+
+QList<YouTubeHlsSegment> YouTubeHlsPlaylist::update(const QByteArray &playlist)
+{
+    QList<YouTubeHlsSegment> segments;
+    qint64 sequence = 0;
+    qint64 discontinuitySequence = 0;
+    bool checked = false;
+    double duration = 0;
+
+    foreach(QByteArray line, playlist.split('\n'))
+    {
+        line = line.trimmed();
+
+        if(line.startsWith("#EXT-X-MEDIA-SEQUENCE:"))
+            sequence = line.mid(22).toLongLong();
+        else if(line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE:"))
+            discontinuitySequence = line.mid(30).toLongLong();
+        else if(line.startsWith("#EXT-X-TARGETDURATION:"))
+            m_targetDuration = qMax(1, line.mid(22).toInt());
+        else if(line.startsWith("#EXTINF:"))
+            duration = line.mid(8, line.indexOf(',') - 8).toDouble();
+        else if(line.startsWith("#EXT-X-ENDLIST"))
+            m_ended = true;
+        else if(!line.isEmpty() && !line.startsWith('#'))
+        {
+            // Both sequence tags come before the first segment
+            if(!checked)
+            {
+                // A restarted stream numbers its segments from scratch
+                if(sequence < m_mediaSequence || discontinuitySequence < m_discontinuitySequence)
+                    m_lastSequence = -1;
+
+                m_mediaSequence = sequence;
+                m_discontinuitySequence = discontinuitySequence;
+                checked = true;
+            }
+
+            // Segments already reported in an earlier reload are skipped
+            if(sequence > m_lastSequence)
+            {
+                YouTubeHlsSegment segment;
+                segment.url = m_url.resolved(QUrl(QString::fromUtf8(line)));
+                segment.sequence = sequence;
+                segment.duration = duration;
+                segments.append(segment);
+            }
+
+            ++sequence;
+            duration = 0;
+        }
+    }
+
+    if(!segments.isEmpty())
+        m_lastSequence = segments.last().sequence;
+
+    return segments;
+}
+
+QList<YouTubeHlsVariant> YouTubeHlsPlaylist::parseMasterPlaylist(const QByteArray &playlist, const QUrl &baseUrl)
+{
+    QList<YouTubeHlsVariant> variants;
+    YouTubeHlsVariant variant;
+    bool pending = false;
+
+    QRegularExpression itagPattern("/itag/(\\d+)/");
+
+    foreach(QByteArray line, playlist.split('\n'))
+    {
+        line = line.trimmed();
+
+        if(line.startsWith("#EXT-X-STREAM-INF:"))
+        {
+            const QMap<QByteArray, QByteArray> attributes = parseAttributes(line.mid(18));
+            const QList<QByteArray> resolution = attributes.value("RESOLUTION").split('x');
+
+            variant = YouTubeHlsVariant();
+            variant.bandwidth = attributes.value("BANDWIDTH").toInt();
+            variant.codecs = attributes.value("CODECS");
+            if(resolution.count() == 2)
+            {
+                variant.width = resolution.at(0).toInt();
+                variant.height = resolution.at(1).toInt();
+            }
+            pending = true;
+        }
+        else if(pending && !line.isEmpty() && !line.startsWith('#'))
+        {
+            variant.url = baseUrl.resolved(QUrl(QString::fromUtf8(line)));
+
+            // YouTube puts the itag in the path; otherwise go by the height
+            QRegularExpressionMatch match = itagPattern.match(variant.url.path());
+            if(match.hasMatch())
+                variant.itag = match.captured(1).toInt();
+
+            for(int i = 0; !variant.itag && i < YouTubeItags::Count; ++i)
+            {
+                const YouTubeItag &itag = YouTubeItags::Table[i];
+                if(itag.container == YouTubeItag::Ts && itag.height == variant.height)
+                    variant.itag = itag.itag;
+            }
+
+            variants.append(variant);
+            pending = false;
+        }
+    }
+
+    return variants;
+}
+
+void YouTubeHlsPlaylist::start()
+{
+    YouTubeExtractorError noError;
+    m_error = noError;
+    m_ended = false;
+    m_failures = 0;
+    refresh();
+}
+
+void YouTubeHlsPlaylist::stop()
+{
+    m_refreshTimer->stop();
+
+    if(m_reply)
+        m_reply->abort();
+}
+
+void YouTubeHlsPlaylist::refresh()
+{
+    if(m_reply)
+        return;
+
+    QNetworkRequest request(m_url);
+
+    // An unchanged playlist then costs a 304 and no body
+    if(!m_etag.isEmpty())
+        request.setRawHeader("If-None-Match", m_etag);
+    if(!m_lastModified.isEmpty())
+        request.setRawHeader("If-Modified-Since", m_lastModified);
+
+    m_reply = m_manager->get(request);
+
+    // A reload that hangs would stall the session. Parented to the reply so that
+    // it goes away with it.
+    QTimer *timer = new QTimer(m_reply);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(onReloadTimeout()));
+    timer->start(m_timeout > 0 ? m_timeout : m_targetDuration * 2000);
+}
+
+void YouTubeHlsPlaylist::onFinished(QNetworkReply *reply)
+{
+    m_reply = 0;
+    reply->deleteLater();
+
+    const bool timedOut = reply->property("timedOut").toBool();
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    try {
+        if(reply->error() == QNetworkReply::OperationCanceledError && !timedOut)
+            return;
+        else if(timedOut)
+        {
+            throw YouTubeExtractorException(YouTubeExtractorError::TimeoutError,
+                                            tr("The HLS playlist reload timed out."));
+        }
+        else if(reply->error() != QNetworkReply::NoError)
+        {
+            throw YouTubeExtractorException(YouTubeExtractorError::NetworkError,
+                                            reply->errorString());
+        }
+
+        bool changed = false;
+        m_failures = 0;
+
+        if(status != 304)
+        {
+            const QByteArray playlist = reply->readAll();
+            if(!playlist.startsWith("#EXTM3U"))
+                throw YouTubeExtractorException(YouTubeExtractorError::ParseError,
+                                                tr("The HLS playlist is not valid."));
+
+            m_etag = reply->rawHeader("ETag");
+            m_lastModified = reply->rawHeader("Last-Modified");
+
+            const QList<YouTubeHlsSegment> segments = update(playlist);
+            changed = !segments.isEmpty();
+            if(changed)
+                emit segmentsReady(segments);
+        }
+
+        if(m_ended)
+        {
+            emit finished();
+            return;
+        }
+
+        // Reload after a target duration, or half of one if nothing was new
+        m_refreshTimer->start(changed ? m_targetDuration * 1000 : m_targetDuration * 500);
+    }
+    catch(YouTubeExtractorException &e)
+    {
+        qDebug() << "YouTubeHlsPlaylist:" << e.text();
+
+        // Timeouts, lost connections and server errors tend to pass; a missing or
+        // forbidden playlist and one that cannot be parsed do not
+        const bool transient = e.code() == YouTubeExtractorError::TimeoutError
+                || (e.code() == YouTubeExtractorError::NetworkError && (status == 0 || status >= 500));
+
+        if(transient && m_failures < MAX_RETRIES)
+        {
+            m_refreshTimer->start(RETRY_DELAY << m_failures);
+            ++m_failures;
+            return;
+        }
+
+        YouTubeExtractorError error(e.code(), e.text());
+        m_error = error;
+        emit finished();
+    }
+}
+
+void YouTubeHlsPlaylist::onReloadTimeout()
+{
+    QTimer *timer = qobject_cast<QTimer *>(sender());
+    if(!timer)
+        return;
+
+    // Only the reload in flight; an earlier one may not be deleted yet
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(timer->parent());
+    if(reply && reply == m_reply && reply->isRunning())
+    {
+        reply->setProperty("timedOut", true);
+        reply->abort();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef YOUTUBEHLSPLAYLIST_H
+#define YOUTUBEHLSPLAYLIST_H
+
+#include <QObject>
+#include <QUrl>
+#include <QList>
+#include <QMetaType>
+#include "youtubeextractor.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+struct YouTubeHlsSegment {
+    YouTubeHlsSegment() :
+        sequence(-1), duration(0) {}
+
+    QUrl url;
+    qint64 sequence;
+    double duration;
+};
+
+Q_DECLARE_METATYPE(YouTubeHlsSegment)
+
+// Follows an HLS media playlist, typically one of the variants of a live broadcast.
+// The playlist is reloaded as the HLS specification suggests and segmentsReady() only
+// reports the segments that were not seen before. Nothing but a few sequence numbers
+// are kept between reloads, so a session can run for as long as the broadcast.
+// A playlist whose media or discontinuity sequence goes back, as happens when the
+// encoder restarts, is taken as a new stream and reported in full.
+// Reloads that time out or fail with a connection or server error are retried with
+// a growing delay; the session only ends after several such failures in a row.
+class YouTubeHlsPlaylist : public QObject
+{
+    Q_OBJECT
+public:
+    explicit YouTubeHlsPlaylist(const QUrl &url, QObject *parent = 0);
+
+    QUrl url() const;
+
+    // Whether the playlist has an end tag, i.e. the broadcast is over
+    bool isEnded() const;
+    int targetDuration() const;
+    qint64 lastSequence() const;
+
+    // Time a reload may take in milliseconds; 0 allows twice the target duration
+    int timeout() const;
+    void setTimeout(int msecs);
+
+    YouTubeExtractorError lastError() const;
+
+    // Returns the segments of a media playlist that are newer than the last ones seen
+    QList<YouTubeHlsSegment> update(const QByteArray &playlist);
+
+    static QList<YouTubeHlsVariant> parseMasterPlaylist(const QByteArray &playlist, const QUrl &baseUrl);
+public slots:
+    void start();
+    void stop();
+private slots:
+    void refresh();
+    void onFinished(QNetworkReply *reply);
+    void onReloadTimeout();
+signals:
+    void segmentsReady(const QList<YouTubeHlsSegment> &segments);
+    void finished();
+private:
+    QUrl m_url;
+    QNetworkAccessManager *m_manager;
+    QNetworkReply *m_reply;
+    QTimer *m_refreshTimer;
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+    qint64 m_lastSequence;
+    qint64 m_mediaSequence;
+    qint64 m_discontinuitySequence;
+    int m_targetDuration;
+    int m_timeout;
+    int m_failures;
+    bool m_ended;
+    YouTubeExtractorError m_error;
+};
+
+#endif // YOUTUBEHLSPLAYLIST_H
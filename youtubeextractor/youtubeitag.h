@@ -0,0 +1,277 @@
+#ifndef YOUTUBEITAG_H
+#define YOUTUBEITAG_H
+
+// Compile-time registry of the YouTube format tags ("itags").
+// Every entry records what a stream of that itag contains; the bitrate is a
+// typical value in kbit/s, audio included, and is only meant for ranking.
+struct YouTubeItag {
+    enum Container {
+        UnknownContainer,
+        Flv,
+        ThreeGp,
+        Mp4,
+        WebM,
+        Ts      // HLS segments
+    };
+
+    enum Codec {
+        NoCodec = 0x0,
+
+        // Video
+        H263 = 0x1,
+        Mp4v = 0x2,
+        H264 = 0x4,
+        Vp8 = 0x8,
+        Vp9 = 0x10,
+        Av1 = 0x20,
+
+        // Audio
+        Mp3 = 0x100,
+        Aac = 0x200,
+        Vorbis = 0x400,
+        Opus = 0x800,
+        Ec3 = 0x1000,
+        Dtse = 0x2000,
+
+        VideoCodecs = 0x3f,
+        AudioCodecs = 0x3f00,
+        AllCodecs = VideoCodecs | AudioCodecs
+    };
+
+    enum Kind {
+        InvalidKind,
+        Muxed,
+        VideoOnly,
+        AudioOnly
+    };
+
+    int itag;
+    Container container;
+    Codec videoCodec;
+    Codec audioCodec;
+    int height;
+    int fps;
+    int bitrate;
+
+    constexpr bool isValid() const { return itag > 0; }
+    constexpr bool hasVideo() const { return videoCodec != NoCodec; }
+    constexpr bool hasAudio() const { return audioCodec != NoCodec; }
+
+    constexpr Kind kind() const
+    {
+        return !isValid() ? InvalidKind
+                          : hasVideo() && hasAudio() ? Muxed
+                                                     : hasVideo() ? VideoOnly : AudioOnly;
+    }
+
+    // Higher is better: streams with sound first, then resolution, frame rate,
+    // container and bitrate
+    constexpr long long rank() const
+    {
+        return !isValid() ? -1
+                          : ((((hasAudio() ? 1LL : 0LL) * 10000 + height) * 100 + fps) * 10
+                             + containerRank(container)) * 100000 + bitrate;
+    }
+
+    // Higher is better: audio bitrate, then codec efficiency
+    constexpr long long audioRank() const
+    {
+        return !hasAudio() ? -1 : bitrate * 10LL + audioCodecRank(audioCodec);
+    }
+
+    static constexpr int audioCodecRank(Codec codec)
+    {
+        return codec == Opus ? 4
+             : codec == Aac ? 3
+             : codec == Vorbis ? 2
+             : codec == Mp3 ? 1
+             : 0;
+    }
+
+    static constexpr int containerRank(Container container)
+    {
+        return container == Mp4 ? 4
+             : container == WebM ? 3
+             : container == Ts ? 2
+             : container == Flv ? 1
+             : 0;
+    }
+
+    static constexpr const YouTubeItag &find(int itag);
+};
+
+namespace YouTubeItags {
+    constexpr YouTubeItag Invalid = { 0, YouTubeItag::UnknownContainer, YouTubeItag::NoCodec, YouTubeItag::NoCodec, 0, 0, 0 };
+
+    constexpr YouTubeItag Table[] = {
+        // Itag Container               Video               Audio                 Height FPS  Bitrate
+        {   5, YouTubeItag::Flv,     YouTubeItag::H263, YouTubeItag::Mp3,      240, 30,   314 },
+        {   6, YouTubeItag::Flv,     YouTubeItag::H263, YouTubeItag::Mp3,      270, 30,   864 },
+        {  13, YouTubeItag::ThreeGp, YouTubeItag::Mp4v, YouTubeItag::Aac,      144, 30,   500 },
+        {  17, YouTubeItag::ThreeGp, YouTubeItag::Mp4v, YouTubeItag::Aac,      144, 12,    74 },
+        {  18, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      360, 30,   596 },
+        {  22, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      720, 30,  2692 },
+        {  34, YouTubeItag::Flv,     YouTubeItag::H264, YouTubeItag::Aac,      360, 30,   628 },
+        {  35, YouTubeItag::Flv,     YouTubeItag::H264, YouTubeItag::Aac,      480, 30,  1128 },
+        {  36, YouTubeItag::ThreeGp, YouTubeItag::Mp4v, YouTubeItag::Aac,      240, 30,   207 },
+        {  37, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,     1080, 30,  3692 },
+        {  38, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,     3072, 30,  4692 },
+        {  43, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   360, 30,   628 },
+        {  44, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   480, 30,  1128 },
+        {  45, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   720, 30,  2192 },
+        {  46, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,  1080, 30,  3192 },
+        {  59, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      480, 30,  1128 },
+        {  78, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      480, 30,  1128 },
+
+        // 3D
+        {  82, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      360, 30,   628 },
+        {  83, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      480, 30,  1128 },
+        {  84, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,      720, 30,  2692 },
+        {  85, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::Aac,     1080, 30,  3692 },
+        { 100, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   360, 30,   628 },
+        { 101, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   480, 30,  1128 },
+        { 102, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::Vorbis,   720, 30,  2192 },
+
+        // HLS
+        {  91, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      144, 30,   148 },
+        {  92, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      240, 30,   298 },
+        {  93, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      360, 30,   828 },
+        {  94, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      480, 30,  1378 },
+        {  95, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      720, 30,  3256 },
+        {  96, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,     1080, 30,  5256 },
+        { 132, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,      240, 30,   298 },
+        { 151, YouTubeItag::Ts,      YouTubeItag::H264, YouTubeItag::Aac,       72, 30,    74 },
+
+        // DASH video, MP4
+        { 133, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  240, 30,   300 },
+        { 134, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  360, 30,   600 },
+        { 135, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  480, 30,  1100 },
+        { 136, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  720, 30,  2300 },
+        { 137, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec, 1080, 30,  4400 },
+        { 138, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec, 2160, 30, 13000 },
+        { 160, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  144, 30,   110 },
+        { 212, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  480, 30,  1100 },
+        { 264, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec, 1440, 30,  9000 },
+        { 266, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec, 2160, 30, 17000 },
+        { 298, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec,  720, 60,  3500 },
+        { 299, YouTubeItag::Mp4,     YouTubeItag::H264, YouTubeItag::NoCodec, 1080, 60,  5500 },
+
+        // DASH video, WebM
+        { 167, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec,  360, 30,   500 },
+        { 168, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec,  480, 30,  1000 },
+        { 169, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec,  720, 30,  2000 },
+        { 170, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec, 1080, 30,  3000 },
+        { 218, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec,  480, 30,  1000 },
+        { 219, YouTubeItag::WebM,    YouTubeItag::Vp8,  YouTubeItag::NoCodec,  480, 30,  1000 },
+        { 242, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  240, 30,   220 },
+        { 243, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  360, 30,   400 },
+        { 244, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  480, 30,   750 },
+        { 245, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  480, 30,   750 },
+        { 246, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  480, 30,   750 },
+        { 247, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  720, 30,  1500 },
+        { 248, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 1080, 30,  2500 },
+        { 271, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 1440, 30,  9000 },
+        { 272, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 2160, 30, 17000 },
+        { 278, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  144, 30,    95 },
+        { 302, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec,  720, 60,  2800 },
+        { 303, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 1080, 60,  4400 },
+        { 308, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 1440, 60, 13000 },
+        { 313, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 2160, 30, 20000 },
+        { 315, YouTubeItag::WebM,    YouTubeItag::Vp9,  YouTubeItag::NoCodec, 2160, 60, 25000 },
+
+        // DASH video, AV1
+        { 394, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec,  144, 30,    80 },
+        { 395, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec,  240, 30,   180 },
+        { 396, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec,  360, 30,   350 },
+        { 397, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec,  480, 30,   650 },
+        { 398, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec,  720, 30,  1300 },
+        { 399, YouTubeItag::Mp4,     YouTubeItag::Av1,  YouTubeItag::NoCodec, 1080, 30,  2300 },
+
+        // DASH audio
+        { 139, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Aac,     0,  0,    48 },
+        { 140, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Aac,     0,  0,   128 },
+        { 141, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Aac,     0,  0,   256 },
+        { 256, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Aac,     0,  0,   192 },
+        { 258, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Aac,     0,  0,   384 },
+        { 325, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Dtse,    0,  0,   384 },
+        { 328, YouTubeItag::Mp4,     YouTubeItag::NoCodec, YouTubeItag::Ec3,     0,  0,   384 },
+        { 171, YouTubeItag::WebM,    YouTubeItag::NoCodec, YouTubeItag::Vorbis,  0,  0,   128 },
+        { 172, YouTubeItag::WebM,    YouTubeItag::NoCodec, YouTubeItag::Vorbis,  0,  0,   256 },
+        { 249, YouTubeItag::WebM,    YouTubeItag::NoCodec, YouTubeItag::Opus,    0,  0,    50 },
+        { 250, YouTubeItag::WebM,    YouTubeItag::NoCodec, YouTubeItag::Opus,    0,  0,    70 },
+        { 251, YouTubeItag::WebM,    YouTubeItag::NoCodec, YouTubeItag::Opus,    0,  0,   160 }
+    };
+
+    constexpr int Count = sizeof(Table) / sizeof(Table[0]);
+
+    constexpr int maxItag()
+    {
+        int max = 0;
+        for(int i = 0; i < Count; ++i)
+            max = Table[i].itag > max ? Table[i].itag : max;
+
+        return max;
+    }
+
+    constexpr int MaxItag = maxItag();
+
+    // Maps an itag to its position in Table plus one; zero marks an unknown itag
+    struct Index {
+        unsigned char slots[MaxItag + 1];
+    };
+
+    constexpr Index makeIndex()
+    {
+        Index index = {};
+        for(int i = 0; i < Count; ++i)
+            index.slots[Table[i].itag] = static_cast<unsigned char>(i + 1);
+
+        return index;
+    }
+
+    constexpr Index Lookup = makeIndex();
+
+    constexpr bool isConsistent(const YouTubeItag &entry)
+    {
+        return entry.isValid()
+                && entry.container != YouTubeItag::UnknownContainer
+                && (entry.hasVideo() || entry.hasAudio())
+                && (entry.videoCodec & YouTubeItag::VideoCodecs) == entry.videoCodec
+                && (entry.audioCodec & YouTubeItag::AudioCodecs) == entry.audioCodec
+                && entry.hasVideo() == (entry.height > 0)
+                && entry.hasVideo() == (entry.fps > 0)
+                && entry.bitrate > 0;
+    }
+
+    constexpr bool checkTable()
+    {
+        static_assert(Count < 255, "Index slots are bytes");
+
+        for(int i = 0; i < Count; ++i)
+        {
+            if(!isConsistent(Table[i]))
+                return false;
+
+            // Catches duplicate itags as well
+            if(Lookup.slots[Table[i].itag] != i + 1)
+                return false;
+        }
+
+        return true;
+    }
+
+    static_assert(checkTable(), "YouTubeItags::Table has an inconsistent or duplicate entry");
+}
+
+constexpr const YouTubeItag &YouTubeItag::find(int itag)
+{
+    return itag > 0 && itag <= YouTubeItags::MaxItag && YouTubeItags::Lookup.slots[itag] > 0
+            ? YouTubeItags::Table[YouTubeItags::Lookup.slots[itag] - 1]
+            : YouTubeItags::Invalid;
+}
+
+static_assert(YouTubeItag::find(22).height == 720, "YouTubeItag::find() is broken");
+static_assert(YouTubeItag::find(251).audioRank() > YouTubeItag::find(140).audioRank(), "YouTubeItag::audioRank() is broken");
+static_assert(!YouTubeItag::find(0).isValid() && !YouTubeItag::find(1000).isValid(), "YouTubeItag::find() is broken");
+
+#endif // YOUTUBEITAG_H
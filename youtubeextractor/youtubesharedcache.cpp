@@ -0,0 +1,250 @@
+#include "youtubesharedcache.h"
+#include <QDateTime>
+#include <atomic>
+#include <cstring>
+
+const quint32 CACHE_MAGIC = 0x59544543; // "YTEC"
+const quint32 CACHE_VERSION = 2;
+
+// A slot owned for this long belongs to a writer that died inside insert()
+const qint64 STALE_WRITER_MSECS = 10000;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The shared cache needs lock-free atomics");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The shared cache needs lock-free atomics");
+
+struct CacheHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 capacity;
+    quint32 slotSize;
+    std::atomic<quint32> clock;
+};
+
+// A slot is this header followed by the payload. The sequence is odd while a
+// writer owns the slot; readers retry when it is odd or changed under them.
+// claimedAt tells how long the current writer has held it.
+struct CacheSlot {
+    std::atomic<quint32> sequence;
+    std::atomic<quint32> lastUsed;
+    std::atomic<qint64> claimedAt;
+    qint64 expiresAt;
+    quint32 payloadSize;
+    quint8 keyLength;
+    char key[YouTubeSharedCache::MaxKeyLength];
+};
+
+const int HEADER_SIZE = (sizeof(CacheHeader) + 7) & ~7;
+const int SLOT_HEADER_SIZE = (sizeof(CacheSlot) + 7) & ~7;
+
+// FNV-1a, so that every process agrees on where a key lives
+static quint32 hashKey(const QByteArray &key)
+{
+    quint32 hash = 2166136261u;
+    for(int i = 0; i < key.size(); ++i)
+    {
+        hash ^= static_cast<quint8>(key.at(i));
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+YouTubeSharedCache::YouTubeSharedCache(const QString &key, int capacity, int slotSize) :
+    m_memory(key),
+    m_capacity(qMax<int>(ProbeLength, capacity)),
+    m_slotSize((qMax(SLOT_HEADER_SIZE + 1024, slotSize) + 7) & ~7),
+    m_hits(0),
+    m_misses(0)
+{
+    const int size = HEADER_SIZE + m_capacity * m_slotSize;
+
+    if(!m_memory.attach() && !m_memory.create(size))
+    {
+        // Another process may have created it in the meantime
+        if(m_memory.error() != QSharedMemory::AlreadyExists || !m_memory.attach())
+        {
+            m_errorString = m_memory.errorString();
+            return;
+        }
+    }
+
+    // Whoever gets here first lays out the table
+    m_memory.lock();
+
+    CacheHeader *header = static_cast<CacheHeader *>(m_memory.data());
+    if(m_memory.size() < HEADER_SIZE)
+    {
+        m_errorString = QStringLiteral("Incompatible shared cache segment.");
+    }
+    else if(header->magic != CACHE_MAGIC)
+    {
+        // The process that created the segment may have asked for fewer slots
+        const int capacity = qMin(m_capacity, (m_memory.size() - HEADER_SIZE) / m_slotSize);
+
+        if(capacity < ProbeLength)
+        {
+            m_errorString = QStringLiteral("The shared cache segment is too small.");
+        }
+        else
+        {
+            m_capacity = capacity;
+            std::memset(m_memory.data(), 0, HEADER_SIZE + m_capacity * m_slotSize);
+            header->version = CACHE_VERSION;
+            header->capacity = m_capacity;
+            header->slotSize = m_slotSize;
+            header->magic = CACHE_MAGIC;
+        }
+    }
+    else if(header->version != CACHE_VERSION || m_memory.size() < HEADER_SIZE
+            + static_cast<int>(header->capacity) * static_cast<int>(header->slotSize))
+    {
+        m_errorString = QStringLiteral("Incompatible shared cache segment.");
+    }
+    else
+    {
+        // Use the geometry of the segment that is already there
+        m_capacity = header->capacity;
+        m_slotSize = header->slotSize;
+    }
+
+    m_memory.unlock();
+
+    if(!m_errorString.isEmpty())
+        m_memory.detach();
+}
+
+bool YouTubeSharedCache::isAttached() const
+{
+    return m_memory.isAttached();
+}
+
+int YouTubeSharedCache::maxPayloadSize() const
+{
+    return m_slotSize - SLOT_HEADER_SIZE;
+}
+
+bool YouTubeSharedCache::find(const QString &entryKey, QByteArray *payload)
+{
+    const QByteArray key = entryKey.toUtf8();
+    if(!isAttached() || key.isEmpty() || key.size() > MaxKeyLength || !payload)
+        return false;
+
+    CacheHeader *header = static_cast<CacheHeader *>(m_memory.data());
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const quint32 hash = hashKey(key);
+
+    for(int probe = 0; probe < ProbeLength; ++probe)
+    {
+        CacheSlot *slot = reinterpret_cast<CacheSlot *>(slotAt((hash + probe) % m_capacity));
+
+        // A few attempts are enough; a slot that keeps changing is as good as a miss
+        for(int attempt = 0; attempt < 4; ++attempt)
+        {
+            const quint32 sequence = slot->sequence.load(std::memory_order_acquire);
+            if(sequence & 1)
+                continue;
+
+            const bool match = slot->keyLength == key.size()
+                    && std::memcmp(slot->key, key.constData(), key.size()) == 0;
+            const qint64 expiresAt = slot->expiresAt;
+            const int payloadSize = qMin<quint32>(slot->payloadSize, maxPayloadSize());
+
+            if(match)
+                payload->resize(payloadSize);
+            if(match && payloadSize > 0)
+                std::memcpy(payload->data(), reinterpret_cast<char *>(slot) + SLOT_HEADER_SIZE, payloadSize);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot->sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+
+            if(!match)
+                break;
+
+            if(expiresAt <= now)
+            {
+                ++m_misses;
+                return false;
+            }
+
+            slot->lastUsed.store(header->clock.fetch_add(1, std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+            ++m_hits;
+            return true;
+        }
+    }
+
+    ++m_misses;
+    return false;
+}
+
+bool YouTubeSharedCache::insert(const QString &entryKey, const QByteArray &payload, qint64 expiresAt)
+{
+    const QByteArray key = entryKey.toUtf8();
+    if(!isAttached() || key.isEmpty() || key.size() > MaxKeyLength || payload.size() > maxPayloadSize())
+        return false;
+
+    CacheHeader *header = static_cast<CacheHeader *>(m_memory.data());
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const quint32 hash = hashKey(key);
+
+    // Prefer the slot already holding the key, then an empty or expired one,
+    // then the least recently used one
+    CacheSlot *victim = 0;
+    qint64 victimScore = 0;
+
+    for(int probe = 0; probe < ProbeLength; ++probe)
+    {
+        CacheSlot *slot = reinterpret_cast<CacheSlot *>(slotAt((hash + probe) % m_capacity));
+
+        // Racy reads are fine here: the choice is only a hint, ownership is taken below
+        qint64 score;
+        if(slot->keyLength == key.size() && std::memcmp(slot->key, key.constData(), key.size()) == 0)
+            score = Q_INT64_C(1) << 62;
+        else if(slot->keyLength == 0 || slot->expiresAt <= now)
+            score = Q_INT64_C(1) << 61;
+        else
+            score = static_cast<quint32>(header->clock.load(std::memory_order_relaxed)
+                                         - slot->lastUsed.load(std::memory_order_relaxed));
+
+        if(!victim || score > victimScore)
+        {
+            victim = slot;
+            victimScore = score;
+        }
+    }
+
+    const qint64 nowMsecs = QDateTime::currentMSecsSinceEpoch();
+    quint32 sequence = victim->sequence.load(std::memory_order_acquire);
+
+    // Another writer owns the slot; dropping this entry is cheaper than waiting,
+    // unless the owner has held it so long that it must have died
+    if((sequence & 1) && nowMsecs - victim->claimedAt.load(std::memory_order_relaxed) < STALE_WRITER_MSECS)
+        return false;
+
+    // Stamped before the claim, so that whoever sees the slot owned knows since when.
+    // Taking over a stale slot keeps the sequence odd.
+    const quint32 claimed = (sequence & 1) ? sequence + 2 : sequence + 1;
+    victim->claimedAt.store(nowMsecs, std::memory_order_relaxed);
+    if(!victim->sequence.compare_exchange_strong(sequence, claimed, std::memory_order_acq_rel))
+        return false;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    victim->keyLength = key.size();
+    std::memcpy(victim->key, key.constData(), key.size());
+    victim->expiresAt = expiresAt;
+    victim->payloadSize = payload.size();
+    std::memcpy(reinterpret_cast<char *>(victim) + SLOT_HEADER_SIZE, payload.constData(), payload.size());
+    victim->lastUsed.store(header->clock.fetch_add(1, std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+
+    // A writer that was taken for dead must not publish over the one that took over
+    quint32 owned = claimed;
+    return victim->sequence.compare_exchange_strong(owned, claimed + 1, std::memory_order_release);
+}
+
+//region Private
+char *YouTubeSharedCache::slotAt(int index) const
+{
+    return static_cast<char *>(const_cast<void *>(m_memory.constData())) + HEADER_SIZE + index * m_slotSize;
+}
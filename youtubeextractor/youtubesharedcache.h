@@ -0,0 +1,53 @@
+#ifndef YOUTUBESHAREDCACHE_H
+#define YOUTUBESHAREDCACHE_H
+
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QString>
+
+// Cache of extraction results shared by every process on the host that opens it
+// with the same key. Entries live in an open-addressing hash table inside a
+// QSharedMemory segment and are keyed by short strings; the extractor uses the
+// video ID together with a hash of its stream filters. Each slot is protected by a
+// seqlock, so readers never block and never see a half-written entry. A slot left
+// owned by a writer that died is taken over by the next writer after a while.
+// The table has a fixed size; once a probe window is full the least recently
+// used or an expired entry is overwritten.
+class YouTubeSharedCache {
+public:
+    enum {
+        DefaultCapacity = 256,
+        DefaultSlotSize = 32 * 1024,
+        ProbeLength = 8,
+        MaxKeyLength = 32
+    };
+
+    explicit YouTubeSharedCache(const QString &key,
+                                int capacity = DefaultCapacity,
+                                int slotSize = DefaultSlotSize);
+
+    bool isAttached() const;
+    QString errorString() const { return m_errorString; }
+
+    int capacity() const { return m_capacity; }
+    int maxPayloadSize() const;
+
+    // expiresAt is in seconds since the epoch; expired entries are never returned
+    bool find(const QString &entryKey, QByteArray *payload);
+    bool insert(const QString &entryKey, const QByteArray &payload, qint64 expiresAt);
+
+    // Counted for this process only
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+private:
+    QSharedMemory m_memory;
+    int m_capacity;
+    int m_slotSize;
+    int m_hits;
+    int m_misses;
+    QString m_errorString;
+
+    char *slotAt(int index) const;
+};
+
+#endif // YOUTUBESHAREDCACHE_H
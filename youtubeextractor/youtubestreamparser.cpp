@@ -0,0 +1,219 @@
+#include "youtubestreamparser.h"
+
+static QString recordSizeError(int maxRecordSize)
+{
+    return QStringLiteral("Stream record exceeds %1 bytes.").arg(maxRecordSize);
+}
+
+YouTubeStreamParser::YouTubeStreamParser(int maxRecordSize) :
+    m_maxRecordSize(maxRecordSize),
+    m_state(KeyState),
+    m_scanFrom(0),
+    m_hasStreamMap(false)
+{
+}
+
+bool YouTubeStreamParser::feed(const QByteArray &data)
+{
+    if(hasError())
+        return false;
+
+    m_buffer.append(data);
+    parse();
+
+    if(hasError())
+    {
+        m_buffer.clear();
+        return false;
+    }
+
+    // Whatever is left is an incomplete key, value or record
+    if(m_buffer.size() > m_maxRecordSize)
+    {
+        switch(m_state)
+        {
+        case StreamMapState:
+            m_errorString = recordSizeError(m_maxRecordSize);
+            m_buffer.clear();
+            return false;
+        default:
+            // Nothing we need is that long; drop the field and wait for the next one
+            m_state = SkipState;
+            m_buffer.clear();
+            m_scanFrom = 0;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool YouTubeStreamParser::finish()
+{
+    if(hasError())
+        return false;
+
+    // The last field is not followed by '&'
+    switch(m_state)
+    {
+    case ValueState:
+        appendField(m_buffer.constData(), m_buffer.size());
+        break;
+    case StreamMapState:
+        appendStreamQuery(m_buffer);
+        break;
+    default:
+        break;
+    }
+
+    m_state = KeyState;
+    m_buffer.clear();
+    m_scanFrom = 0;
+
+    return true;
+}
+
+QList<QByteArray> YouTubeStreamParser::takeStreamQueries()
+{
+    QList<QByteArray> streamQueries;
+    streamQueries.swap(m_streamQueries);
+
+    return streamQueries;
+}
+
+//region Private
+void YouTubeStreamParser::parse()
+{
+    const char *data = m_buffer.constData();
+    const int size = m_buffer.size();
+    int pos = 0;
+    int end = pos + m_scanFrom;
+    bool complete = true;
+
+    while(complete && pos < size)
+    {
+        switch(m_state)
+        {
+        case KeyState:
+            while(end < size && data[end] != '=' && data[end] != '&')
+                ++end;
+
+            if(end == size)
+            {
+                complete = false;
+                break;
+            }
+
+            // A key without a value carries nothing
+            if(data[end] == '=')
+            {
+                m_key = QByteArray(data + pos, end - pos);
+                if(m_key == "url_encoded_fmt_stream_map" || m_key == "adaptive_fmts")
+                {
+                    m_hasStreamMap = true;
+                    m_state = StreamMapState;
+                }
+                else
+                {
+                    m_state = ValueState;
+                }
+            }
+
+            pos = end = end + 1;
+            break;
+        case ValueState:
+            while(end < size && data[end] != '&')
+                ++end;
+
+            if(end == size)
+            {
+                complete = false;
+                break;
+            }
+
+            if(end - pos <= m_maxRecordSize)
+                appendField(data + pos, end - pos);
+            m_state = KeyState;
+            pos = end = end + 1;
+            break;
+        case StreamMapState:
+        {
+            // Records are separated by an encoded comma ("%2C") and the map ends at '&'
+            int separatorLength = 0;
+            while(end < size)
+            {
+                if(data[end] == '&')
+                {
+                    separatorLength = 1;
+                    break;
+                }
+                if(data[end] == '%')
+                {
+                    if(end + 2 >= size)
+                        break;
+                    if(data[end + 1] == '2' && (data[end + 2] | 0x20) == 'c')
+                    {
+                        separatorLength = 3;
+                        break;
+                    }
+                }
+                ++end;
+            }
+
+            if(separatorLength == 0)
+            {
+                complete = false;
+                break;
+            }
+
+            // A record that arrived whole in one chunk never sits in the buffer
+            if(end - pos > m_maxRecordSize)
+            {
+                m_errorString = recordSizeError(m_maxRecordSize);
+                complete = false;
+                break;
+            }
+
+            appendStreamQuery(QByteArray(data + pos, end - pos));
+            if(separatorLength == 1)
+                m_state = KeyState;
+            pos = end = end + separatorLength;
+            break;
+        }
+        case SkipState:
+            while(end < size && data[end] != '&')
+                ++end;
+
+            if(end == size)
+            {
+                // Nothing to keep until the next field starts
+                pos = end = size;
+                break;
+            }
+
+            m_state = KeyState;
+            pos = end = end + 1;
+            break;
+        }
+    }
+
+    m_scanFrom = qMax(0, end - pos);
+    m_buffer.remove(0, pos);
+}
+
+void YouTubeStreamParser::appendField(const char *value, int length)
+{
+    // Decoding is left to whoever reads the field
+    if(!m_rawFields.isEmpty())
+        m_rawFields.append('&');
+
+    m_rawFields.append(m_key);
+    m_rawFields.append('=');
+    m_rawFields.append(value, length);
+}
+
+void YouTubeStreamParser::appendStreamQuery(const QByteArray &record)
+{
+    if(!record.isEmpty())
+        m_streamQueries.append(QByteArray::fromPercentEncoding(record));
+}
@@ -0,0 +1,57 @@
+#ifndef YOUTUBESTREAMPARSER_H
+#define YOUTUBESTREAMPARSER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// Incremental parser for get_video_info responses.
+// The response is fed in chunks as it arrives. Each comma-delimited record of the
+// stream maps becomes available as soon as it is complete, so only the record being
+// received is kept in memory rather than the whole response.
+class YouTubeStreamParser {
+public:
+    enum { DefaultMaxRecordSize = 64 * 1024 };
+
+    explicit YouTubeStreamParser(int maxRecordSize = DefaultMaxRecordSize);
+
+    // Both return false once the parser has failed
+    bool feed(const QByteArray &data);
+    bool finish();
+
+    bool hasError() const { return !m_errorString.isEmpty(); }
+    QString errorString() const { return m_errorString; }
+
+    // Whether "url_encoded_fmt_stream_map" or "adaptive_fmts" has been seen
+    bool hasStreamMap() const { return m_hasStreamMap; }
+
+    // Decoded stream records completed since the last call
+    QList<QByteArray> takeStreamQueries();
+
+    // Top-level fields other than the stream maps, still encoded, as a query string.
+    // Fields longer than the maximum record size are skipped.
+    QByteArray rawFields() const { return m_rawFields; }
+private:
+    enum State {
+        KeyState,
+        ValueState,
+        StreamMapState,
+        SkipState
+    };
+
+    int m_maxRecordSize;
+    State m_state;
+    QByteArray m_buffer;
+    int m_scanFrom;
+    QByteArray m_key;
+    bool m_hasStreamMap;
+    QList<QByteArray> m_streamQueries;
+    QByteArray m_rawFields;
+    QString m_errorString;
+
+    void parse();
+    void appendStreamQuery(const QByteArray &record);
+    void appendField(const char *value, int length);
+};
+
+#endif // YOUTUBESTREAMPARSER_H
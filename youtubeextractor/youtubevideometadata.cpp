@@ -0,0 +1,182 @@
+#include "youtubevideometadata.h"
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// Form decoding: '+' stands for a space and the rest is percent encoded
+static QString decodeValue(const QByteArray &value)
+{
+    QByteArray decoded = value;
+    decoded.replace('+', ' ');
+
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(decoded));
+}
+
+// Splits a comma separated value, leaving out empty entries
+static QStringList splitList(const QString &value)
+{
+    QStringList entries = value.split(',');
+    entries.removeAll(QString());
+
+    return entries;
+}
+
+YouTubeVideoMetadata::YouTubeVideoMetadata()
+{
+}
+
+YouTubeVideoMetadata::YouTubeVideoMetadata(const QString &videoId, const QByteArray &query) :
+    m_videoId(videoId),
+    m_query(query)
+{
+}
+
+bool YouTubeVideoMetadata::isEmpty() const
+{
+    return m_query.isEmpty();
+}
+
+QString YouTubeVideoMetadata::videoId() const
+{
+    return m_videoId;
+}
+
+QByteArray YouTubeVideoMetadata::rawQuery() const
+{
+    return m_query;
+}
+
+bool YouTubeVideoMetadata::contains(const QString &key) const
+{
+    return m_values.contains(key) || indexOfValue(key.toUtf8()) >= 0;
+}
+
+QString YouTubeVideoMetadata::value(const QString &key) const
+{
+    QHash<QString, QString>::const_iterator it = m_values.constFind(key);
+    if(it != m_values.constEnd())
+        return it.value();
+
+    const int start = indexOfValue(key.toUtf8());
+    if(start < 0)
+        return QString();
+
+    int end = m_query.indexOf('&', start);
+    if(end < 0)
+        end = m_query.size();
+
+    // Only fields that are there are cached, so that contains() can trust the cache
+    const QString value = decodeValue(m_query.mid(start, end - start));
+    m_values.insert(key, value);
+
+    return value;
+}
+
+QString YouTubeVideoMetadata::title() const
+{
+    return value("title");
+}
+
+QString YouTubeVideoMetadata::author() const
+{
+    return value("author");
+}
+
+int YouTubeVideoMetadata::lengthSeconds() const
+{
+    return value("length_seconds").toInt();
+}
+
+qint64 YouTubeVideoMetadata::viewCount() const
+{
+    return value("view_count").toLongLong();
+}
+
+QStringList YouTubeVideoMetadata::keywords() const
+{
+    return splitList(value("keywords"));
+}
+
+QList<YouTubeCaptionTrack> YouTubeVideoMetadata::captionTracks() const
+{
+    QList<YouTubeCaptionTrack> tracks;
+
+    // A comma separated list of query strings, e.g. "u=...&lc=en&n=English"
+    foreach(const QString &entry, splitList(value("caption_tracks")))
+    {
+        const YouTubeVideoMetadata track(QString(), entry.toUtf8());
+
+        YouTubeCaptionTrack caption;
+        caption.languageCode = track.value("lc");
+        caption.name = track.value("n");
+        caption.url = QUrl(track.value("u"));
+        tracks.append(caption);
+    }
+
+    return tracks;
+}
+
+QJsonObject YouTubeVideoMetadata::toJson() const
+{
+    QJsonArray keywords;
+    foreach(const QString &keyword, this->keywords())
+        keywords.append(keyword);
+
+    QJsonArray captionTracks;
+    foreach(const YouTubeCaptionTrack &track, this->captionTracks())
+    {
+        QJsonObject caption;
+        caption.insert("languageCode", track.languageCode);
+        caption.insert("name", track.name);
+        caption.insert("url", track.url.toString());
+        captionTracks.append(caption);
+    }
+
+    QJsonObject object;
+    object.insert("videoId", m_videoId);
+    object.insert("title", title());
+    object.insert("author", author());
+    object.insert("lengthSeconds", lengthSeconds());
+    object.insert("viewCount", static_cast<double>(viewCount()));
+    object.insert("keywords", keywords);
+    object.insert("captionTracks", captionTracks);
+
+    return object;
+}
+
+qint64 YouTubeVideoMetadata::exportNdjson(const QList<YouTubeVideoMetadata> &metadata, QIODevice *device)
+{
+    if(!device || !device->isWritable())
+        return -1;
+
+    qint64 count = 0;
+    foreach(const YouTubeVideoMetadata &entry, metadata)
+    {
+        QByteArray line = QJsonDocument(entry.toJson()).toJson(QJsonDocument::Compact);
+        line.append('\n');
+
+        if(device->write(line) != line.size())
+            return -1;
+
+        ++count;
+    }
+
+    return count;
+}
+
+//region Private
+int YouTubeVideoMetadata::indexOfValue(const QByteArray &key) const
+{
+    if(key.isEmpty())
+        return -1;
+
+    // Encoded values hold no '&' or '=', so a match at a field boundary is the key itself
+    const QByteArray field = key + '=';
+    if(m_query.startsWith(field))
+        return field.size();
+
+    const int index = m_query.indexOf('&' + field);
+
+    return index < 0 ? -1 : index + 1 + field.size();
+}
@@ -0,0 +1,55 @@
+#ifndef YOUTUBEVIDEOMETADATA_H
+#define YOUTUBEVIDEOMETADATA_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+class QIODevice;
+class QJsonObject;
+
+struct YouTubeCaptionTrack {
+    QString languageCode;
+    QString name;
+    QUrl url;
+};
+
+// Metadata of a video as returned by get_video_info.
+// Only the raw, still encoded query string is stored; a field is looked up and
+// decoded the first time it is asked for, so callers only pay for what they read.
+// Copies are cheap. A single instance must not be read from several threads at once.
+class YouTubeVideoMetadata {
+public:
+    YouTubeVideoMetadata();
+    YouTubeVideoMetadata(const QString &videoId, const QByteArray &query);
+
+    bool isEmpty() const;
+    QString videoId() const;
+    QByteArray rawQuery() const;
+
+    bool contains(const QString &key) const;
+    QString value(const QString &key) const;
+
+    QString title() const;
+    QString author() const;
+    int lengthSeconds() const;
+    qint64 viewCount() const;
+    QStringList keywords() const;
+    QList<YouTubeCaptionTrack> captionTracks() const;
+
+    QJsonObject toJson() const;
+
+    // Writes one compact JSON object per line and returns the number written, or -1 on error
+    static qint64 exportNdjson(const QList<YouTubeVideoMetadata> &metadata, QIODevice *device);
+private:
+    QString m_videoId;
+    QByteArray m_query;
+    mutable QHash<QString, QString> m_values;
+
+    int indexOfValue(const QByteArray &key) const;
+};
+
+#endif // YOUTUBEVIDEOMETADATA_H